@@ -49,6 +49,11 @@ public class DTSImport : ModuleRules
 
         PrivateDependencyModuleNames.AddRange(new string[] {
             "UnrealEd", // for UFactory
+            "MeshDescription",
+            "StaticMeshDescription",
+            "MeshDescriptionOperations", // MikkTSpace reference in DtsBench
+            "AssetRegistry",
+            "RenderCore", // PackedNormal.h
         });
 
         DynamicallyLoadedModuleNames.AddRange(new string[] {});
@@ -1,7 +1,11 @@
 
 
 #include "DtsFactory.h"
+#include "DtsStream.h"
+#include "DtsShape.h"
+#include "DtsDedup.h"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -9,109 +13,109 @@
 // http://docs.garagegames.com/torque-3d/official/content/documentation/Artist%20Guide/Formats/dts_format.html
 
 
-enum DTSMeshType : uint32_t
-{
-	StandardMeshType = 0,
-	SkinMeshType = 1,
-	DecalMeshType = 2,
-	SortedMeshType = 3,
-	NullMeshType = 4,
-	// flags stored with meshType:
-	//UseEncodedNormals = BIT(28),
-	//BillboardZAxis = BIT(29),
-	//HasDetailTexture = BIT(30),
-	//Billboard = BIT(31),
-};
 
 
 
 template<typename T>
-T GetValue(uint8*& data, int64& dataSize)
+T GetValue(FDtsStream& stream)
 {
-	//uint32_t sizeMemBuffer = *((uint32_t*)data); data += sizeof(uint32_t); dataSize -= sizeof(uint32_t);
-	checkf(dataSize >= sizeof(T), TEXT("Buffer empty"));
-	if (dataSize >= sizeof(T))
-	{
-		T t = *((T*)data); data += sizeof(T); dataSize -= sizeof(T);
-		return t;
-	}
-	return 0;
+	T t = 0;
+	bool ok = stream.read(&t, sizeof(T));
+	return ok ? t : 0;
 }
 
 
-template<typename T, typename B>
-T GetValue(B*& memBuffer, uint32_t& sizeMemBuffer)
+// Counts come from the file: a usable one is not negative and its elements fit in what is left of the stream
+bool CheckCount(int32_t count, int64 elementSize, const FDtsStream& stream)
 {
-	checkf(sizeMemBuffer > 0, TEXT("Buffer empty"));
-	if (sizeMemBuffer > 0)
-	{
-		T t = *((T*)memBuffer); memBuffer++; sizeMemBuffer--;
-		return t;
-	}
-	return 0;
+	return count >= 0 && int64(count) * elementSize <= stream.remaining();
 }
 
 
-std::vector<uint32_t> GetBitset(uint8*& data, int64& dataSize)
+std::vector<uint32_t> GetBitset(FDtsStream& data)
 {
 	std::vector<uint32_t> out;
-	int32_t dummy = GetValue<int32_t>(data, dataSize);
-	int32_t numWords = GetValue<int32_t>(data, dataSize);
+	int32_t dummy = GetValue<int32_t>(data);
+	int32_t numWords = GetValue<int32_t>(data);
+	if (!CheckCount(numWords, sizeof(uint32_t), data))
+	{
+		data.fail();
+		return out;
+	}
 	for (auto i = 0; i < numWords; i++)
 	{
-		uint32_t value = GetValue<uint32_t>(data, dataSize);
+		uint32_t value = GetValue<uint32_t>(data);
 		out.push_back(value);
 	}
 	return out;
 }
 
 
-std::string GetPascalString(uint8*& data, int64& dataSize)
+std::string GetPascalString(FDtsStream& data)
 {
 	std::string out;
-	uint8_t numBytes = GetValue<uint8_t>(data, dataSize);
+	uint8_t numBytes = GetValue<uint8_t>(data);
 	for (auto i = 0; i < numBytes; i++)
 	{
-		char c = GetValue<char>(data, dataSize);
+		char c = GetValue<char>(data);
 		out += c;
 	}
 	return out;
 }
 
 
-FVector GetVector(uint32_t*& memBuffer32, uint32_t& sizeMemBuffer32)
+FVector GetVector(FDtsStream& memBuffer32)
 {
-	float x = GetValue<float>(memBuffer32, sizeMemBuffer32);
-	float y = GetValue<float>(memBuffer32, sizeMemBuffer32);
-	float z = GetValue<float>(memBuffer32, sizeMemBuffer32);
+	float x = GetValue<float>(memBuffer32);
+	float y = GetValue<float>(memBuffer32);
+	float z = GetValue<float>(memBuffer32);
 	return FVector(x, y, z);
 }
 
 
-FBox GetBox(uint32_t*& memBuffer32, uint32_t& sizeMemBuffer32)
+FBox GetBox(FDtsStream& memBuffer32)
 {
-	FVector min = GetVector(memBuffer32, sizeMemBuffer32);
-	FVector max = GetVector(memBuffer32, sizeMemBuffer32);
+	FVector min = GetVector(memBuffer32);
+	FVector max = GetVector(memBuffer32);
 	return FBox(min, max);
 }
 
 
-FQuat GetQuat16(uint16_t*& memBuffer16, uint32_t& sizeMemBuffer16)
+FQuat GetQuat16(FDtsStream& memBuffer16)
+{
+	int16_t x = GetValue<int16_t>(memBuffer16);
+	int16_t y = GetValue<int16_t>(memBuffer16);
+	int16_t z = GetValue<int16_t>(memBuffer16);
+	int16_t w = GetValue<int16_t>(memBuffer16);
+	const float scale = 1.0f / 32767.0f;											// Quat16 stores each component as value * 0x7FFF
+	return FQuat(x * scale, y * scale, z * scale, w * scale);
+}
+
+
+// 4-byte length followed by the characters, no terminating NULL
+std::string GetSizedString(FDtsStream& data)
 {
-	int16_t x = GetValue<int16_t>(memBuffer16, sizeMemBuffer16);
-	int16_t y = GetValue<int16_t>(memBuffer16, sizeMemBuffer16);
-	int16_t z = GetValue<int16_t>(memBuffer16, sizeMemBuffer16);
-	int16_t w = GetValue<int16_t>(memBuffer16, sizeMemBuffer16);
-	return FQuat(x, y, z, w);
+	std::string out;
+	int32_t numBytes = GetValue<int32_t>(data);
+	if (!CheckCount(numBytes, 1, data))
+	{
+		data.fail();
+		return out;
+	}
+	for (auto i = 0; i < numBytes; i++)
+	{
+		out += GetValue<char>(data);
+	}
+	return out;
 }
 
 
-std::string GetString(uint8_t*& memBuffer8, uint32_t& sizeMemBuffer8)
+std::string GetString(FDtsStream& memBuffer8)
 {
 	std::string out;
 	for (;;)
 	{
-		char c = GetValue<char>(memBuffer8, sizeMemBuffer8);
+		char c = GetValue<char>(memBuffer8);
 		if (c == 0)
 		{
 			break;
@@ -122,13 +126,12 @@ std::string GetString(uint8_t*& memBuffer8, uint32_t& sizeMemBuffer8)
 }
 
 
-bool CheckGuard(uint32_t& guardValue, uint32_t*& memBuffer32, uint32_t& sizeMemBuffer32, uint16_t*& memBuffer16, uint32_t& sizeMemBuffer16, uint8_t*& memBuffer8, uint32_t& sizeMemBuffer8)
+bool CheckGuard(uint32_t& guardValue, FDtsStream& memBuffer32, FDtsStream& memBuffer16, FDtsStream& memBuffer8)
 {
-	uint32_t val32 = GetValue<uint32_t>(memBuffer32, sizeMemBuffer32);
-	uint16_t val16 = GetValue<uint16_t>(memBuffer16, sizeMemBuffer16);
-	uint8_t val8 = GetValue<uint8_t>(memBuffer8, sizeMemBuffer8);
+	uint32_t val32 = GetValue<uint32_t>(memBuffer32);
+	uint16_t val16 = GetValue<uint16_t>(memBuffer16);
+	uint8_t val8 = GetValue<uint8_t>(memBuffer8);
 	guardValue++;
-	checkf(val32 == val16 && val16 == val8 && val8 == (guardValue - 1), TEXT("Guard failed"));
 	if (val32 != val16 || val16 != val8 || val8 != (guardValue - 1))
 	{
 		return false;
@@ -137,519 +140,972 @@ bool CheckGuard(uint32_t& guardValue, uint32_t*& memBuffer32, uint32_t& sizeMemB
 }
 
 
-bool UDtsFactory::parseDtsData(UObject*& createdObject, uint8* data, int64 dataSize)
+// DTS header: version, total membuffer size and the starts of the 16-bit and 8-bit regions (in 32-bit words)
+struct FDtsHeader
+{
+	uint32_t version;
+	uint32_t sizeMemBuffer;
+	uint32_t startU16;
+	uint32_t startU8;
+};
+
+
+static bool ReadHeader(const uint8* data, int64 dataSize, FDtsHeader& header)
+{
+	if (dataSize < int64(sizeof(FDtsHeader)))
+	{
+		return false;
+	}
+	FMemory::Memcpy(&header, data, sizeof(FDtsHeader));
+	header.version &= 0xFFFF;
+	if (header.version < 19 || header.startU16 > header.startU8 || header.startU8 > header.sizeMemBuffer)
+	{
+		return false;
+	}
+	return sizeof(FDtsHeader) + int64(header.sizeMemBuffer) * 4 <= dataSize;
+}
+
+
+bool UDtsFactory::parseDtsData(FDtsShape& shape, uint8* data, int64 dataSize)
 {
-	uint32_t version = GetValue<uint32_t>(data, dataSize) & 0xFFFF;
-	if (version < 19)
-	{
-		return false;
-	}
-
-	uint32_t sizeMemBuffer = GetValue<uint32_t>(data, dataSize);
-	uint32_t startU16      = GetValue<uint32_t>(data, dataSize);
-	uint32_t startU8       = GetValue<uint32_t>(data, dataSize);
-	uint32_t sizeMemBuffer32 = startU16 * 4;
-	uint32_t sizeMemBuffer16 = startU8 * 4 - startU16 * 4;
-	uint32_t sizeMemBuffer8 = sizeMemBuffer * 4 - startU8 * 4;
-	uint32_t* memBuffer32  = (uint32_t*)data; data += sizeMemBuffer32;
-	uint16_t* memBuffer16  = (uint16_t*)data; data += sizeMemBuffer16;
-	uint8_t* memBuffer8    = (uint8_t*)data;  data += sizeMemBuffer8;
-	parseMembuffers(version, memBuffer32, sizeMemBuffer32, memBuffer16, sizeMemBuffer16, memBuffer8, sizeMemBuffer8);
-	dataSize -= sizeMemBuffer * 4;
-
-	int32_t numSequences   = GetValue<int32_t>(data, dataSize);
-	for (auto num = 0; num < numSequences; num++)
-	{
-		parseSequence(version, data, dataSize);
-	}
-
-	int8_t matStreamType = GetValue<int8_t>(data, dataSize);
-	if (matStreamType == 1)
-	{
-		int32_t numMaterials = GetValue<int32_t>(data, dataSize);
-		for (auto num = 0; num < numMaterials; num++)
-		{
-			std::string matName = GetPascalString(data, dataSize);			// Names of the materials in the shape. Each name is stored as a 4-byte length followed by the N characters in the string (terminating NULL is not included in the length or N characters).
-		}
-		for (auto num = 0; num < numMaterials; num++)
-		{
-			uint32_t matFlags = GetValue<uint32_t>(data, dataSize);			// Flags for each material*
-		}
-		for (auto num = 0; num < numMaterials; num++)
-		{
-			int32_t matReflectanceMaps = GetValue<int32_t>(data, dataSize);	// Index of the material to use as a reflectance map for each material* (or -1 for none)
-		}
-		for (auto num = 0; num < numMaterials; num++)
-		{
-			int32_t matBumpMaps = GetValue<int32_t>(data, dataSize);		// Index of the material to use as a bump map for each material* (or -1 for none)
-		}
-		for (auto num = 0; num < numMaterials; num++)
-		{
-			int32_t matDetailMaps = GetValue<int32_t>(data, dataSize);		// Index of the material to use as a detail map for each material* (or -1 for none)
-		}
-		if (version == 25)
-		{
-			for (auto num = 0; num < numMaterials; num++)
-			{
-				int32_t dummy = GetValue<int32_t>(data, dataSize);			// Dummy value. Only present in DTS v25.
-			}
-		}
-		for (auto num = 0; num < numMaterials; num++)
-		{
-			float matDetailScales = GetValue<float>(data, dataSize);		// Detail scale for each material*
-		}
-		for (auto num = 0; num < numMaterials; num++)
-		{
-			float matReflectance = GetValue<float>(data, dataSize);			// Reflectance value for each material*
+	FDtsHeader header;
+	if (!ReadHeader(data, dataSize, header))
+	{
+		return false;
+	}
+	data += sizeof(FDtsHeader);
+	uint32_t sizeMemBuffer32 = header.startU16 * 4;
+	uint32_t sizeMemBuffer16 = header.startU8 * 4 - header.startU16 * 4;
+	uint32_t sizeMemBuffer8 = header.sizeMemBuffer * 4 - header.startU8 * 4;
+	FDtsStream memBuffer32(data, sizeMemBuffer32); data += sizeMemBuffer32;
+	FDtsStream memBuffer16(data, sizeMemBuffer16); data += sizeMemBuffer16;
+	FDtsStream memBuffer8(data, sizeMemBuffer8);   data += sizeMemBuffer8;
+	FDtsStream tail(data, dataSize - sizeof(FDtsHeader) - int64(header.sizeMemBuffer) * 4);
+	return parseDtsStreams(shape, header.version, memBuffer32, memBuffer16, memBuffer8, tail);
+}
+
+
+bool UDtsFactory::parseDtsFile(FDtsShape& shape, const FString& filename, int64 fileSize, int64 windowSize)
+{
+	uint8 headerData[sizeof(FDtsHeader)];
+	{
+		FDtsStream headerStream(filename, 0, sizeof(FDtsHeader), sizeof(FDtsHeader));
+		if (!headerStream.isValid() || !headerStream.read(headerData, sizeof(FDtsHeader)))
+		{
+			return false;
 		}
 	}
+	FDtsHeader header;
+	if (!ReadHeader(headerData, fileSize, header))
+	{
+		return false;
+	}
+	const int64 offset32 = sizeof(FDtsHeader);
+	const int64 offset16 = offset32 + int64(header.startU16) * 4;
+	const int64 offset8 = offset32 + int64(header.startU8) * 4;
+	const int64 offsetTail = offset32 + int64(header.sizeMemBuffer) * 4;
+	FDtsStream memBuffer32(filename, offset32, offset16 - offset32, windowSize);
+	FDtsStream memBuffer16(filename, offset16, offset8 - offset16, windowSize);
+	FDtsStream memBuffer8(filename, offset8, offsetTail - offset8, windowSize);
+	FDtsStream tail(filename, offsetTail, fileSize - offsetTail, windowSize);
+	if (!memBuffer32.isValid() || !memBuffer16.isValid() || !memBuffer8.isValid() || !tail.isValid())
+	{
+		return false;
+	}
+	return parseDtsStreams(shape, header.version, memBuffer32, memBuffer16, memBuffer8, tail);
+}
 
-	return true;
+
+bool UDtsFactory::parseDtsStreams(FDtsShape& shape, uint32_t version, FDtsStream& memBuffer32, FDtsStream& memBuffer16, FDtsStream& memBuffer8, FDtsStream& data)
+{
+	shape.version = version;
+	if (!parseMembuffers(version, shape, memBuffer32, memBuffer16, memBuffer8))
+	{
+		return false;
+	}
+
+	int32_t numSequences   = GetValue<int32_t>(data);
+	if (!CheckCount(numSequences, 15 * sizeof(int32_t), data))
+	{
+		return false;
+	}
+	shape.sequences.resize(numSequences);
+	for (auto num = 0; num < numSequences && !data.hasFailed(); num++)
+	{
+		parseSequence(version, shape.sequences[num], data);
+	}
+
+	int8_t matStreamType = GetValue<int8_t>(data);
+	if (matStreamType == 1)
+	{
+		int32_t numMaterials = GetValue<int32_t>(data);
+		if (!CheckCount(numMaterials, 1 + 6 * sizeof(int32_t), data))
+		{
+			return false;
+		}
+		shape.materials.resize(numMaterials);
+		for (auto num = 0; num < numMaterials; num++)
+		{
+			shape.materials[num].name = GetPascalString(data);			// Names of the materials in the shape. Each name is stored as a 4-byte length followed by the N characters in the string (terminating NULL is not included in the length or N characters).
+		}
+		for (auto num = 0; num < numMaterials; num++)
+		{
+			shape.materials[num].flags = GetValue<uint32_t>(data);			// Flags for each material*
+		}
+		for (auto num = 0; num < numMaterials; num++)
+		{
+			shape.materials[num].reflectanceMap = GetValue<int32_t>(data);	// Index of the material to use as a reflectance map for each material* (or -1 for none)
+		}
+		for (auto num = 0; num < numMaterials; num++)
+		{
+			shape.materials[num].bumpMap = GetValue<int32_t>(data);		// Index of the material to use as a bump map for each material* (or -1 for none)
+		}
+		for (auto num = 0; num < numMaterials; num++)
+		{
+			shape.materials[num].detailMap = GetValue<int32_t>(data);		// Index of the material to use as a detail map for each material* (or -1 for none)
+		}
+		if (version == 25)
+		{
+			for (auto num = 0; num < numMaterials; num++)
+			{
+				int32_t dummy = GetValue<int32_t>(data);			// Dummy value. Only present in DTS v25.
+			}
+		}
+		for (auto num = 0; num < numMaterials; num++)
+		{
+			shape.materials[num].detailScale = GetValue<float>(data);		// Detail scale for each material*
+		}
+		for (auto num = 0; num < numMaterials; num++)
+		{
+			shape.materials[num].reflectance = GetValue<float>(data);			// Reflectance value for each material*
+		}
+	}
+
+	return !memBuffer32.hasFailed() && !memBuffer16.hasFailed() && !memBuffer8.hasFailed() && !data.hasFailed();
 }
 
 
-void UDtsFactory::parseMembuffers(uint32_t version, uint32_t* memBuffer32, uint32_t sizeMemBuffer32, uint16_t* memBuffer16, uint32_t sizeMemBuffer16, uint8_t* memBuffer8, uint32_t sizeMemBuffer8)
+bool UDtsFactory::parseMembuffers(uint32_t version, FDtsShape& shape, FDtsStream& memBuffer32, FDtsStream& memBuffer16, FDtsStream& memBuffer8)
 {
 	uint32_t guardValue = 0;
 
-	int32_t numNodes = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);				// Number of nodes in the shape
-	int32_t numObjects = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);			// Number of objects in the shape
-	int32_t numDecals = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);			// Number of decals in the shape
-	int32_t numSubShapes = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);			// Number of subshapes in the shape
-	int32_t numIFLs = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);				// Number of IFL materials in the shape
-	int32_t numNodeRotations = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);		// Number of node rotation keyframes
-	int32_t numNodeTranslations = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);	// Number of node translation keyframes
-	int32_t numNodeUniformScales = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);	// Number of node uniform scale keyframes
-	int32_t numNodeAlignedScales = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);	// Number of node aligned scale keyframes
-	int32_t numNodeArbScales = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);		// Number of node arbitrary scale keyframes
-	int32_t numGroundFrames = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);		// Number of ground transform keyframes
-	int32_t numObjectStates = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);		// Number of object state keyframes
-	int32_t numDecalStates = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);		// Number of decal state keyframes
-	int32_t numTriggers = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);			// Number of triggers (all sequences)
-	int32_t numDetails = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);			// Number of detail levels in the shape
-	int32_t numMeshes = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);			// Number of meshes (all detail levels) in the shape
-	int32_t numNames = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);				// Number of name strings in the shape
-	float smallestVisibleSize = GetValue<float>(memBuffer32, sizeMemBuffer32);		// Size of the smallest visible detail level
-	int32_t smallestVisibleDL = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);	// Index of the smallest visible detail level
-
-	CheckGuard(guardValue, memBuffer32, sizeMemBuffer32, memBuffer16, sizeMemBuffer16, memBuffer8, sizeMemBuffer8);
-
-	float radius = GetValue<float>(memBuffer32, sizeMemBuffer32);					// Shape bounding sphere radius
-	float tubeRadius = GetValue<float>(memBuffer32, sizeMemBuffer32);				// Shape bounding cylinder radius
-	FVector center = GetVector(memBuffer32, sizeMemBuffer32);						// Center of the shape bounds
-	FBox bounds = GetBox(memBuffer32, sizeMemBuffer32);								// Shape bounding box
-
-	CheckGuard(guardValue, memBuffer32, sizeMemBuffer32, memBuffer16, sizeMemBuffer16, memBuffer8, sizeMemBuffer8);
+	int32_t numNodes = GetValue<int32_t>(memBuffer32);				// Number of nodes in the shape
+	int32_t numObjects = GetValue<int32_t>(memBuffer32);			// Number of objects in the shape
+	int32_t numDecals = GetValue<int32_t>(memBuffer32);			// Number of decals in the shape
+	int32_t numSubShapes = GetValue<int32_t>(memBuffer32);			// Number of subshapes in the shape
+	int32_t numIFLs = GetValue<int32_t>(memBuffer32);				// Number of IFL materials in the shape
+	int32_t numNodeRotations = GetValue<int32_t>(memBuffer32);		// Number of node rotation keyframes
+	int32_t numNodeTranslations = GetValue<int32_t>(memBuffer32);	// Number of node translation keyframes
+	int32_t numNodeUniformScales = GetValue<int32_t>(memBuffer32);	// Number of node uniform scale keyframes
+	int32_t numNodeAlignedScales = GetValue<int32_t>(memBuffer32);	// Number of node aligned scale keyframes
+	int32_t numNodeArbScales = GetValue<int32_t>(memBuffer32);		// Number of node arbitrary scale keyframes
+	int32_t numGroundFrames = GetValue<int32_t>(memBuffer32);		// Number of ground transform keyframes
+	int32_t numObjectStates = GetValue<int32_t>(memBuffer32);		// Number of object state keyframes
+	int32_t numDecalStates = GetValue<int32_t>(memBuffer32);		// Number of decal state keyframes
+	int32_t numTriggers = GetValue<int32_t>(memBuffer32);			// Number of triggers (all sequences)
+	int32_t numDetails = GetValue<int32_t>(memBuffer32);			// Number of detail levels in the shape
+	int32_t numMeshes = GetValue<int32_t>(memBuffer32);			// Number of meshes (all detail levels) in the shape
+	int32_t numNames = GetValue<int32_t>(memBuffer32);				// Number of name strings in the shape
+	shape.smallestVisibleSize = GetValue<float>(memBuffer32);		// Size of the smallest visible detail level
+	shape.smallestVisibleDL = GetValue<int32_t>(memBuffer32);		// Index of the smallest visible detail level
+	const int64 detailSize = (version >= 26 ? 13 : 7) * sizeof(int32_t) + 2 * sizeof(float);
+	if (!CheckCount(numNodes, 5 * sizeof(int32_t) + 3 * sizeof(float), memBuffer32) || !CheckCount(numObjects, 6 * sizeof(int32_t), memBuffer32)
+		|| !CheckCount(numDecals, 5 * sizeof(int32_t), memBuffer32) || !CheckCount(numSubShapes, 6 * sizeof(int32_t), memBuffer32)
+		|| !CheckCount(numIFLs, 5 * sizeof(int32_t), memBuffer32) || !CheckCount(numNodeRotations, 4 * sizeof(int16_t), memBuffer16)
+		|| !CheckCount(numNodeTranslations, 3 * sizeof(float), memBuffer32) || !CheckCount(numNodeUniformScales, sizeof(float), memBuffer32)
+		|| !CheckCount(numNodeAlignedScales, 3 * sizeof(float), memBuffer32) || !CheckCount(numNodeArbScales, 3 * sizeof(float), memBuffer32)
+		|| !CheckCount(numGroundFrames, 3 * sizeof(float), memBuffer32) || !CheckCount(numObjectStates, 3 * sizeof(int32_t), memBuffer32)
+		|| !CheckCount(numDecalStates, sizeof(int32_t), memBuffer32) || !CheckCount(numTriggers, 2 * sizeof(int32_t), memBuffer32)
+		|| !CheckCount(numDetails, detailSize, memBuffer32) || !CheckCount(numMeshes, sizeof(uint32_t), memBuffer32) || !CheckCount(numNames, 1, memBuffer8))
+	{
+		return false;
+	}
+
+	if (!CheckGuard(guardValue, memBuffer32, memBuffer16, memBuffer8))
+	{
+		return false;
+	}
 
+	shape.radius = GetValue<float>(memBuffer32);					// Shape bounding sphere radius
+	shape.tubeRadius = GetValue<float>(memBuffer32);				// Shape bounding cylinder radius
+	shape.center = GetVector(memBuffer32);							// Center of the shape bounds
+	shape.bounds = GetBox(memBuffer32);								// Shape bounding box
+
+	if (!CheckGuard(guardValue, memBuffer32, memBuffer16, memBuffer8))
+	{
+		return false;
+	}
+
+	shape.nodes.resize(numNodes);
 	for (auto i = 0; i < numNodes; i++)												// Array of numNodes Nodes
 	{
-		int32_t nameIndex = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
-		int32_t parentIndex = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
-		int32_t firstObject = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
-		int32_t firstChild = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
-		int32_t nextSibling = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
+		FDtsNode& node = shape.nodes[i];
+		node.nameIndex = GetValue<int32_t>(memBuffer32);
+		node.parentIndex = GetValue<int32_t>(memBuffer32);
+		node.firstObject = GetValue<int32_t>(memBuffer32);
+		node.firstChild = GetValue<int32_t>(memBuffer32);
+		node.nextSibling = GetValue<int32_t>(memBuffer32);
 	}
 
-	CheckGuard(guardValue, memBuffer32, sizeMemBuffer32, memBuffer16, sizeMemBuffer16, memBuffer8, sizeMemBuffer8);
+	if (!CheckGuard(guardValue, memBuffer32, memBuffer16, memBuffer8))
+	{
+		return false;
+	}
 
+	shape.objects.resize(numObjects);
 	for (auto i = 0; i < numObjects; i++)											// Array of numObjects Objects
 	{
-		int32_t nameIndex = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
-		int32_t numMeshes_ = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
-		int32_t startMeshIndex = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
-		int32_t nodeIndex = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
-		int32_t nextSibling = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
-		int32_t firstDecal = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
+		FDtsObject& object = shape.objects[i];
+		object.nameIndex = GetValue<int32_t>(memBuffer32);
+		object.numMeshes = GetValue<int32_t>(memBuffer32);
+		object.startMeshIndex = GetValue<int32_t>(memBuffer32);
+		object.nodeIndex = GetValue<int32_t>(memBuffer32);
+		object.nextSibling = GetValue<int32_t>(memBuffer32);
+		object.firstDecal = GetValue<int32_t>(memBuffer32);
 	}
 
-	CheckGuard(guardValue, memBuffer32, sizeMemBuffer32, memBuffer16, sizeMemBuffer16, memBuffer8, sizeMemBuffer8);
+	if (!CheckGuard(guardValue, memBuffer32, memBuffer16, memBuffer8))
+	{
+		return false;
+	}
 
 	for (auto i = 0; i < numDecals; i++)											// Array of numDecals Decals. Note that decals are deprecated.
 	{
-		int32_t dummy0 = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
-		int32_t dummy1 = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
-		int32_t dummy2 = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
-		int32_t dummy3 = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
-		int32_t dummy4 = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
+		int32_t dummy0 = GetValue<int32_t>(memBuffer32);
+		int32_t dummy1 = GetValue<int32_t>(memBuffer32);
+		int32_t dummy2 = GetValue<int32_t>(memBuffer32);
+		int32_t dummy3 = GetValue<int32_t>(memBuffer32);
+		int32_t dummy4 = GetValue<int32_t>(memBuffer32);
 	}
 
-	CheckGuard(guardValue, memBuffer32, sizeMemBuffer32, memBuffer16, sizeMemBuffer16, memBuffer8, sizeMemBuffer8);
+	if (!CheckGuard(guardValue, memBuffer32, memBuffer16, memBuffer8))
+	{
+		return false;
+	}
 
+	shape.iflMaterials.resize(numIFLs);
 	for (auto i = 0; i < numIFLs; i++)												// Array of numIFLs IflMaterials
 	{
-		int32_t nameIndex = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
-		int32_t materialSlot = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
-		int32_t firstFrame = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
-		int32_t firstFrameOffTimeIndex = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
-		int32_t numFrames = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
+		FDtsIflMaterial& ifl = shape.iflMaterials[i];
+		ifl.nameIndex = GetValue<int32_t>(memBuffer32);
+		ifl.materialSlot = GetValue<int32_t>(memBuffer32);
+		ifl.firstFrame = GetValue<int32_t>(memBuffer32);
+		ifl.firstFrameOffTimeIndex = GetValue<int32_t>(memBuffer32);
+		ifl.numFrames = GetValue<int32_t>(memBuffer32);
 	}
 
-	CheckGuard(guardValue, memBuffer32, sizeMemBuffer32, memBuffer16, sizeMemBuffer16, memBuffer8, sizeMemBuffer8);
+	if (!CheckGuard(guardValue, memBuffer32, memBuffer16, memBuffer8))
+	{
+		return false;
+	}
 
 	for (auto i = 0; i < numSubShapes; i++)												// Array of numSubShapes ints representing the index of the first node in each subshape
 	{
-		int32_t subShapeFirstNode = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
+		shape.subShapeFirstNode.push_back(GetValue<int32_t>(memBuffer32));
 	}
 	for (auto i = 0; i < numSubShapes; i++)												// Array of numSubShapes ints representing the index of the first object in each subshape
 	{
-		int32_t subShapeFirstObject = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
+		shape.subShapeFirstObject.push_back(GetValue<int32_t>(memBuffer32));
 	}
 	for (auto i = 0; i < numSubShapes; i++)												// Array of numSubShapes ints representing the index of the first decal in each subshape
 	{
-		int32_t subShapeFirstDecal = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
+		int32_t subShapeFirstDecal = GetValue<int32_t>(memBuffer32);
 	}
 
-	CheckGuard(guardValue, memBuffer32, sizeMemBuffer32, memBuffer16, sizeMemBuffer16, memBuffer8, sizeMemBuffer8);
+	if (!CheckGuard(guardValue, memBuffer32, memBuffer16, memBuffer8))
+	{
+		return false;
+	}
 
 	for (auto i = 0; i < numSubShapes; i++)
 	{
-		int32_t subShapeNumNodes = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
+		shape.subShapeNumNodes.push_back(GetValue<int32_t>(memBuffer32));
 	}
 	for (auto i = 0; i < numSubShapes; i++)
 	{
-		int32_t subShapeNumObjects = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
+		shape.subShapeNumObjects.push_back(GetValue<int32_t>(memBuffer32));
 	}
 	for (auto i = 0; i < numSubShapes; i++)
 	{
-		int32_t subShapeNumDecals = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
+		int32_t subShapeNumDecals = GetValue<int32_t>(memBuffer32);
 	}
 
-	CheckGuard(guardValue, memBuffer32, sizeMemBuffer32, memBuffer16, sizeMemBuffer16, memBuffer8, sizeMemBuffer8);
+	if (!CheckGuard(guardValue, memBuffer32, memBuffer16, memBuffer8))
+	{
+		return false;
+	}
 
 	for (auto i = 0; i < numNodes; i++)													// Array of numNodes quaternions for default node rotations
 	{
-		FQuat defaultRotation = GetQuat16(memBuffer16, sizeMemBuffer16);
+		shape.nodes[i].defaultRotation = GetQuat16(memBuffer16);
 	}
 	for (auto i = 0; i < numNodes; i++)													// Array of numNodes points for default node translations
 	{
-		FVector defaultTranslation = GetVector(memBuffer32, sizeMemBuffer32);
+		shape.nodes[i].defaultTranslation = GetVector(memBuffer32);
 	}
+	shape.nodeRotations.resize(numNodeRotations);
 	for (auto i = 0; i < numNodeRotations; i++)											// Array of numNodeRotations quaternions for node rotation keyframes (all sequences)
 	{
-		FQuat nodeRotation = GetQuat16(memBuffer16, sizeMemBuffer16);
+		shape.nodeRotations[i] = GetQuat16(memBuffer16);
 	}
+	shape.nodeTranslations.resize(numNodeTranslations);
 	for (auto i = 0; i < numNodeTranslations; i++)										// Array of numNodeTranslations points for node translation keyframes (all sequences)
 	{
-		FVector nodeTranslation = GetVector(memBuffer32, sizeMemBuffer32);
+		shape.nodeTranslations[i] = GetVector(memBuffer32);
 	}
 
-	CheckGuard(guardValue, memBuffer32, sizeMemBuffer32, memBuffer16, sizeMemBuffer16, memBuffer8, sizeMemBuffer8);
+	if (!CheckGuard(guardValue, memBuffer32, memBuffer16, memBuffer8))
+	{
+		return false;
+	}
 
+	shape.nodeUniformScales.resize(numNodeUniformScales);
 	for (auto i = 0; i < numNodeUniformScales; i++)										// Array of numNodeUniformScales floats for node uniform scale keyframes (all sequences)
 	{
-		float nodeUniformScale = GetValue<float>(memBuffer32, sizeMemBuffer32);
+		shape.nodeUniformScales[i] = GetValue<float>(memBuffer32);
 	}
+	shape.nodeAlignedScales.resize(numNodeAlignedScales);
 	for (auto i = 0; i < numNodeAlignedScales; i++)										// Array of numNodeAlignedScales points for node aligned scale keyframes (all sequences)
 	{
-		FVector nodeAlignedScale = GetVector(memBuffer32, sizeMemBuffer32);
+		shape.nodeAlignedScales[i] = GetVector(memBuffer32);
 	}
+	shape.nodeArbScaleFactors.resize(numNodeArbScales);
 	for (auto i = 0; i < numNodeArbScales; i++)											// Array of numNodeArbScales points for node arbitrary scale factor keyframes (all sequences)
 	{
-		FVector nodeArbScaleFactor = GetVector(memBuffer32, sizeMemBuffer32);
+		shape.nodeArbScaleFactors[i] = GetVector(memBuffer32);
 	}
+	shape.nodeArbScaleRots.resize(numNodeArbScales);
 	for (auto i = 0; i < numNodeArbScales; i++)											// Array of numNodeArbScales quaternions for node arbitrary scale rotation keyframes (all sequences)
 	{
-		FQuat nodeArbScaleRot = GetQuat16(memBuffer16, sizeMemBuffer16);
+		shape.nodeArbScaleRots[i] = GetQuat16(memBuffer16);
 	}
 
-	CheckGuard(guardValue, memBuffer32, sizeMemBuffer32, memBuffer16, sizeMemBuffer16, memBuffer8, sizeMemBuffer8);
+	if (!CheckGuard(guardValue, memBuffer32, memBuffer16, memBuffer8))
+	{
+		return false;
+	}
 
+	shape.groundTranslations.resize(numGroundFrames);
 	for (auto i = 0; i < numGroundFrames; i++)											// Array of numGroundFrames points for ground transform keyframes (all sequences)
 	{
-		FVector groundTranslation = GetVector(memBuffer32, sizeMemBuffer32);
+		shape.groundTranslations[i] = GetVector(memBuffer32);
 	}
+	shape.groundRotations.resize(numGroundFrames);
 	for (auto i = 0; i < numGroundFrames; i++)											// Array of numGroundFrames quaternions for ground transform keyframes (all sequences)
 	{
-		FQuat groundRotation = GetQuat16(memBuffer16, sizeMemBuffer16);
+		shape.groundRotations[i] = GetQuat16(memBuffer16);
 	}
 
-	CheckGuard(guardValue, memBuffer32, sizeMemBuffer32, memBuffer16, sizeMemBuffer16, memBuffer8, sizeMemBuffer8);
+	if (!CheckGuard(guardValue, memBuffer32, memBuffer16, memBuffer8))
+	{
+		return false;
+	}
 
+	shape.objectStates.resize(numObjectStates);
 	for (auto i = 0; i < numObjectStates; i++)											// Array of numObjectStates ObjectStates
 	{
-		float vis = GetValue<float>(memBuffer32, sizeMemBuffer32);
-		int32_t frameIndex = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
-		int32_t matFrame = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
+		shape.objectStates[i].vis = GetValue<float>(memBuffer32);
+		shape.objectStates[i].frameIndex = GetValue<int32_t>(memBuffer32);
+		shape.objectStates[i].matFrame = GetValue<int32_t>(memBuffer32);
 	}
 
-	CheckGuard(guardValue, memBuffer32, sizeMemBuffer32, memBuffer16, sizeMemBuffer16, memBuffer8, sizeMemBuffer8);
+	if (!CheckGuard(guardValue, memBuffer32, memBuffer16, memBuffer8))
+	{
+		return false;
+	}
 
 	for (auto i = 0; i < numDecalStates; i++)											// Array of numDecalStates dummy integers for decal states
 	{
-		int32_t decalState = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
+		int32_t decalState = GetValue<int32_t>(memBuffer32);
 	}
 
-	CheckGuard(guardValue, memBuffer32, sizeMemBuffer32, memBuffer16, sizeMemBuffer16, memBuffer8, sizeMemBuffer8);
+	if (!CheckGuard(guardValue, memBuffer32, memBuffer16, memBuffer8))
+	{
+		return false;
+	}
 
+	shape.triggers.resize(numTriggers);
 	for (auto i = 0; i < numTriggers; i++)												// Array of numTriggers sequence triggers (all sequences)
 	{
-		uint32_t state = GetValue<uint32_t>(memBuffer32, sizeMemBuffer32);
-		uint32_t pos = GetValue<uint32_t>(memBuffer32, sizeMemBuffer32);
+		shape.triggers[i].state = GetValue<uint32_t>(memBuffer32);
+		shape.triggers[i].pos = GetValue<float>(memBuffer32);
 	}
 
-	CheckGuard(guardValue, memBuffer32, sizeMemBuffer32, memBuffer16, sizeMemBuffer16, memBuffer8, sizeMemBuffer8);
+	if (!CheckGuard(guardValue, memBuffer32, memBuffer16, memBuffer8))
+	{
+		return false;
+	}
 
+	shape.details.resize(numDetails);
 	for (auto i = 0; i < numDetails; i++)												// Array of numDetails Details
 	{
-		int32_t nameIndex = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
-		int32_t subShapeNum = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
-		int32_t objectDetailNum = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
-		float size = GetValue<float>(memBuffer32, sizeMemBuffer32);
-		float averageError = GetValue<float>(memBuffer32, sizeMemBuffer32);
-		float maxError = GetValue<float>(memBuffer32, sizeMemBuffer32);
-		int32_t polyCount = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
+		FDtsDetail& detail = shape.details[i];
+		detail.nameIndex = GetValue<int32_t>(memBuffer32);
+		detail.subShapeNum = GetValue<int32_t>(memBuffer32);
+		detail.objectDetailNum = GetValue<int32_t>(memBuffer32);
+		detail.size = GetValue<float>(memBuffer32);
+		detail.averageError = GetValue<float>(memBuffer32);
+		detail.maxError = GetValue<float>(memBuffer32);
+		detail.polyCount = GetValue<int32_t>(memBuffer32);
 		if (version >= 26)
 		{
-			int32_t bbDimension = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
-			int32_t bbDetailLevel = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
-			uint32_t bbEquatorSteps = GetValue<uint32_t>(memBuffer32, sizeMemBuffer32);
-			uint32_t bbPolarSteps = GetValue<uint32_t>(memBuffer32, sizeMemBuffer32);
-			float bbPolarAngle = GetValue<float>(memBuffer32, sizeMemBuffer32);
-			uint32_t bbIncludePoles = GetValue<uint32_t>(memBuffer32, sizeMemBuffer32);
+			detail.bbDimension = GetValue<int32_t>(memBuffer32);
+			detail.bbDetailLevel = GetValue<int32_t>(memBuffer32);
+			detail.bbEquatorSteps = GetValue<uint32_t>(memBuffer32);
+			detail.bbPolarSteps = GetValue<uint32_t>(memBuffer32);
+			detail.bbPolarAngle = GetValue<float>(memBuffer32);
+			detail.bbIncludePoles = GetValue<uint32_t>(memBuffer32);
 		}
 	}
 
-	CheckGuard(guardValue, memBuffer32, sizeMemBuffer32, memBuffer16, sizeMemBuffer16, memBuffer8, sizeMemBuffer8);
+	if (!CheckGuard(guardValue, memBuffer32, memBuffer16, memBuffer8))
+	{
+		return false;
+	}
 
+	shape.meshes.resize(numMeshes);
+	FDtsMeshDeduplicator deduplicator;
 	for (auto i = 0; i < numMeshes; i++)												// Array of numMeshes Meshes
 	{
-		parseMesh(version, guardValue, memBuffer32, sizeMemBuffer32, memBuffer16, sizeMemBuffer16, memBuffer8, sizeMemBuffer8);
+		if (!parseMesh(version, shape.meshes[i], guardValue, memBuffer32, memBuffer16, memBuffer8))
+		{
+			return false;
+		}
+		deduplicator.add(shape, i);
 	}
 
-	CheckGuard(guardValue, memBuffer32, sizeMemBuffer32, memBuffer16, sizeMemBuffer16, memBuffer8, sizeMemBuffer8);
+	if (!CheckGuard(guardValue, memBuffer32, memBuffer16, memBuffer8))
+	{
+		return false;
+	}
 
+	shape.names.resize(numNames);
 	for (auto i = 0; i < numNames; i++)												// Array of numNames strings, stored as N characters followed by a terminating NULL for each string.
 	{
-		std::string name = GetString(memBuffer8, sizeMemBuffer8);
+		shape.names[i] = GetString(memBuffer8);
 	}
 
-	CheckGuard(guardValue, memBuffer32, sizeMemBuffer32, memBuffer16, sizeMemBuffer16, memBuffer8, sizeMemBuffer8);
+	if (!CheckGuard(guardValue, memBuffer32, memBuffer16, memBuffer8))
+	{
+		return false;
+	}
 
 	for (auto i = 0; i < numDetails; i++)												// Array of numDetails floats representing alpha-in value for each detail
 	{
-		float alphaIn = GetValue<float>(memBuffer32, sizeMemBuffer32);
+		shape.details[i].alphaIn = GetValue<float>(memBuffer32);
 	}
 	for (auto i = 0; i < numDetails; i++)												// Array of numDetails floats representing alpha-out value for each detail
 	{
-		float alphaOut = GetValue<float>(memBuffer32, sizeMemBuffer32);
+		shape.details[i].alphaOut = GetValue<float>(memBuffer32);
 	}
+	return true;
 }
 
 
-void UDtsFactory::parseSequence(uint32_t version, uint8*& data, int64& dataSize)
+void UDtsFactory::parseSequence(uint32_t version, FDtsSequence& sequence, FDtsStream& data, bool readNameIndex)
 {
-	int32_t nameIndex = GetValue<int32_t>(data, dataSize);					// The name of this sequence as in index into the names array
-	uint32_t flags = GetValue<uint32_t>(data, dataSize);					// Sequence flags
-	int32_t numKeyframes = GetValue<int32_t>(data, dataSize);				// Number of keyframes in this sequence
-	float duration = GetValue<float>(data, dataSize);						// Duration of the sequence (in seconds)
-	int32_t priority = GetValue<int32_t>(data, dataSize);					// Sequence priority
-	int32_t firstGroundFrame = GetValue<int32_t>(data, dataSize);			// First ground transform keyframe in this sequence (index into the groundTranslations and groundRotation arrays)
-	int32_t numGroundFrames = GetValue<int32_t>(data, dataSize);			// Number of ground transform keyframes in this sequence
-	int32_t baseRotation = GetValue<int32_t>(data, dataSize);				// First node rotation keyframe in this sequence (index into the nodeRotations array)
-	int32_t baseTranslation = GetValue<int32_t>(data, dataSize);			// First node translation keyframe in this sequence (index into the nodeTranslations array)
-	int32_t baseScale = GetValue<int32_t>(data, dataSize);					// First node scale keyframe in this sequence (index into the nodeXXXScales arrays)
-	int32_t baseObjectState = GetValue<int32_t>(data, dataSize);			// First object state keyframe in this sequence (index into the objectStates array)
-	int32_t baseDecalState = GetValue<int32_t>(data, dataSize);				// First decal state keyframe in this sequence (index into the decalStates array). Note that DTS decals are deprecated, and this value should be 0.
-	int32_t firstTrigger = GetValue<int32_t>(data, dataSize);				// First trigger in this sequence (index into the triggers array)
-	int32_t numTriggers = GetValue<int32_t>(data, dataSize);				// Number of triggers in this sequence
-	float toolBegin = GetValue<float>(data, dataSize);						// Value representing the start of this sequence in the exporting tool's timeline (can usually by ignored)
-	std::vector<uint32_t> rotationMatters = GetBitset(data, dataSize);		// BitSet indicating which node rotations are animated by this sequence.
-	std::vector<uint32_t> translationMatters = GetBitset(data, dataSize);	// BitSet indicating which node translations are animated by this sequence.
-	std::vector<uint32_t> scaleMatters = GetBitset(data, dataSize);			// BitSet indicating which node scales are animated by this sequence.
-	std::vector<uint32_t> decalMatters = GetBitset(data, dataSize);			// BitSet indicating which decal states are animated by this sequence. Note that DTS decals are deprecated.
-	std::vector<uint32_t> iflMatters = GetBitset(data, dataSize);			// BitSet indicating which IFL materials are animated by this sequence.
-	std::vector<uint32_t> visMatters = GetBitset(data, dataSize);			// BitSet indicating which object's visibility is animated by this sequence.
-	std::vector<uint32_t> frameMatters = GetBitset(data, dataSize);			// BitSet indicating which mesh's verts are animated by this sequence.
-	std::vector<uint32_t> matFrameMatters = GetBitset(data, dataSize);		// BitSet indicating which mesh's UV coords are animated by this sequence.
+	if (readNameIndex)
+	{
+		sequence.nameIndex = GetValue<int32_t>(data);			// The name of this sequence as in index into the names array
+	}
+	sequence.flags = GetValue<uint32_t>(data);					// Sequence flags
+	sequence.numKeyframes = GetValue<int32_t>(data);			// Number of keyframes in this sequence
+	sequence.duration = GetValue<float>(data);					// Duration of the sequence (in seconds)
+	sequence.priority = GetValue<int32_t>(data);				// Sequence priority
+	sequence.firstGroundFrame = GetValue<int32_t>(data);		// First ground transform keyframe in this sequence (index into the groundTranslations and groundRotation arrays)
+	sequence.numGroundFrames = GetValue<int32_t>(data);			// Number of ground transform keyframes in this sequence
+	sequence.baseRotation = GetValue<int32_t>(data);			// First node rotation keyframe in this sequence (index into the nodeRotations array)
+	sequence.baseTranslation = GetValue<int32_t>(data);			// First node translation keyframe in this sequence (index into the nodeTranslations array)
+	sequence.baseScale = GetValue<int32_t>(data);				// First node scale keyframe in this sequence (index into the nodeXXXScales arrays)
+	sequence.baseObjectState = GetValue<int32_t>(data);			// First object state keyframe in this sequence (index into the objectStates array)
+	sequence.baseDecalState = GetValue<int32_t>(data);			// First decal state keyframe in this sequence (index into the decalStates array). Note that DTS decals are deprecated, and this value should be 0.
+	sequence.firstTrigger = GetValue<int32_t>(data);			// First trigger in this sequence (index into the triggers array)
+	sequence.numTriggers = GetValue<int32_t>(data);				// Number of triggers in this sequence
+	sequence.toolBegin = GetValue<float>(data);					// Value representing the start of this sequence in the exporting tool's timeline (can usually by ignored)
+	sequence.rotationMatters = GetBitset(data);					// BitSet indicating which node rotations are animated by this sequence.
+	sequence.translationMatters = GetBitset(data);				// BitSet indicating which node translations are animated by this sequence.
+	sequence.scaleMatters = GetBitset(data);					// BitSet indicating which node scales are animated by this sequence.
+	sequence.decalMatters = GetBitset(data);					// BitSet indicating which decal states are animated by this sequence. Note that DTS decals are deprecated.
+	sequence.iflMatters = GetBitset(data);						// BitSet indicating which IFL materials are animated by this sequence.
+	sequence.visMatters = GetBitset(data);						// BitSet indicating which object's visibility is animated by this sequence.
+	sequence.frameMatters = GetBitset(data);					// BitSet indicating which mesh's verts are animated by this sequence.
+	sequence.matFrameMatters = GetBitset(data);					// BitSet indicating which mesh's UV coords are animated by this sequence.
+}
+
+
+// Keys of one channel (numKeyframes per animated node, nodes in bitset order) rewritten from a DSQ's node order to the
+// base shape's. Nodes the base shape lacks are dropped.
+template<typename T>
+static void RemapNodeKeys(const std::vector<int32_t>& nodeMap, int32_t numKeyframes, std::vector<uint32_t>& matters, int32_t& firstKey,
+	const std::vector<T>& keys, std::vector<T>& remapped)
+{
+	std::vector<std::pair<int32_t, int32_t>> animated;		// base node, first key in keys
+	int32_t key = firstKey;
+	for (auto i = 0; i < int32_t(nodeMap.size()); i++)
+	{
+		if (i / 32 < int32_t(matters.size()) && (matters[i / 32] & (1u << (i % 32))))
+		{
+			if (nodeMap[i] >= 0)
+			{
+				animated.emplace_back(nodeMap[i], key);
+			}
+			key += numKeyframes;
+		}
+	}
+	std::sort(animated.begin(), animated.end());
+
+	matters.clear();
+	firstKey = remapped.size();
+	for (const auto& node : animated)
+	{
+		if (node.first / 32 >= int32_t(matters.size()))
+		{
+			matters.resize(node.first / 32 + 1, 0);
+		}
+		matters[node.first / 32] |= 1u << (node.first % 32);
+		for (auto k = 0; k < numKeyframes; k++)
+		{
+			const int32_t index = node.second + k;
+			remapped.push_back(index >= 0 && index < int32_t(keys.size()) ? keys[index] : T());
+		}
+	}
 }
 
 
-void UDtsFactory::parseMesh(uint32_t version, uint32_t& guardValue, uint32_t*& memBuffer32, uint32_t& sizeMemBuffer32, uint16_t*& memBuffer16, uint32_t& sizeMemBuffer16, uint8_t*& memBuffer8, uint32_t& sizeMemBuffer8)
+bool UDtsFactory::parseDsqData(FDtsShape& shape, const FDtsShape& baseShape, uint8* data, int64 dataSize)
 {
+	FDtsStream dsq(data, dataSize);
+	if (dataSize < int64(sizeof(uint32_t)))
+	{
+		return false;
+	}
+	const uint32_t version = GetValue<uint32_t>(dsq) & 0xFFFF;					// Version (exporter version in the high 16 bits)
+	if (version < 22)
+	{
+		return false;
+	}
+	shape.version = version;
+	shape.nodes = baseShape.nodes;
+	shape.names = baseShape.names;
 
-	uint32_t meshType = GetValue<uint32_t>(memBuffer32, sizeMemBuffer32);		// Type of mesh
+	// Nodes are matched to the base shape by name, ignoring case like Torque
+	TMap<FString, int32> baseNodes;
+	for (auto i = 0; i < int32_t(baseShape.nodes.size()); i++)
+	{
+		baseNodes.Add(FString(UTF8_TO_TCHAR(baseShape.getName(baseShape.nodes[i].nameIndex).c_str())).ToLower(), i);
+	}
+	int32_t numNodes = GetValue<int32_t>(dsq);									// Number of nodes animated by the file, followed by their names
+	if (!CheckCount(numNodes, sizeof(int32_t), dsq))
+	{
+		return false;
+	}
+	std::vector<int32_t> nodeMap(numNodes);
+	for (auto i = 0; i < numNodes; i++)
+	{
+		const FString nodeName = FString(UTF8_TO_TCHAR(GetSizedString(dsq).c_str())).ToLower();
+		const int32* baseNode = baseNodes.Find(nodeName);
+		nodeMap[i] = baseNode ? *baseNode : -1;
+		if (!baseNode)
+		{
+			UE_LOG(LogDts, Warning, TEXT("Sequence node [%s] not found in the base shape"), *nodeName);
+		}
+	}
+	int32_t numObjects = GetValue<int32_t>(dsq);								// Number of objects (unused)
+
+	int32_t numNodeRotations = GetValue<int32_t>(dsq);							// Node rotation keyframes
+	if (!CheckCount(numNodeRotations, 4 * sizeof(int16_t), dsq))
+	{
+		return false;
+	}
+	std::vector<FQuat> nodeRotations(numNodeRotations);
+	for (FQuat& rotation : nodeRotations)
+	{
+		rotation = GetQuat16(dsq);
+	}
+	int32_t numNodeTranslations = GetValue<int32_t>(dsq);						// Node translation keyframes
+	if (!CheckCount(numNodeTranslations, 3 * sizeof(float), dsq))
+	{
+		return false;
+	}
+	std::vector<FVector> nodeTranslations(numNodeTranslations);
+	for (FVector& translation : nodeTranslations)
+	{
+		translation = GetVector(dsq);
+	}
+	int32_t numNodeUniformScales = GetValue<int32_t>(dsq);						// Node uniform scale keyframes
+	if (!CheckCount(numNodeUniformScales, sizeof(float), dsq) || !dsq.skip(int64(numNodeUniformScales) * sizeof(float)))
+	{
+		return false;
+	}
+	int32_t numNodeAlignedScales = GetValue<int32_t>(dsq);						// Node aligned scale keyframes
+	if (!CheckCount(numNodeAlignedScales, sizeof(float) * 3, dsq) || !dsq.skip(int64(numNodeAlignedScales) * sizeof(float) * 3))
+	{
+		return false;
+	}
+	int32_t numNodeArbScales = GetValue<int32_t>(dsq);							// Node arbitrary scale rotations, then as many scale factors
+	if (!CheckCount(numNodeArbScales, sizeof(int16_t) * 4 + sizeof(float) * 3, dsq) || !dsq.skip(int64(numNodeArbScales) * (sizeof(int16_t) * 4 + sizeof(float) * 3)))
+	{
+		return false;
+	}
+	int32_t numGroundFrames = GetValue<int32_t>(dsq);							// Ground translations, then as many ground rotations
+	if (!CheckCount(numGroundFrames, 3 * sizeof(float) + 4 * sizeof(int16_t), dsq))
+	{
+		return false;
+	}
+	shape.groundTranslations.resize(numGroundFrames);
+	for (FVector& translation : shape.groundTranslations)
+	{
+		translation = GetVector(dsq);
+	}
+	shape.groundRotations.resize(numGroundFrames);
+	for (FQuat& rotation : shape.groundRotations)
+	{
+		rotation = GetQuat16(dsq);
+	}
+	int32_t numObjectStates = GetValue<int32_t>(dsq);							// Object states: vis, frameIndex, matFrame
+	if (!CheckCount(numObjectStates, 12, dsq) || !dsq.skip(int64(numObjectStates) * 12))
+	{
+		return false;
+	}
+	int32_t numDecalStates = GetValue<int32_t>(dsq);							// Decal states
+	if (!CheckCount(numDecalStates, sizeof(int32_t), dsq) || !dsq.skip(int64(numDecalStates) * sizeof(int32_t)))
+	{
+		return false;
+	}
+
+	int32_t numSequences = GetValue<int32_t>(dsq);
+	if (!CheckCount(numSequences, 15 * sizeof(int32_t), dsq))
+	{
+		return false;
+	}
+	shape.sequences.resize(numSequences);
+	for (FDtsSequence& sequence : shape.sequences)
+	{
+		if (dsq.hasFailed())
+		{
+			return false;
+		}
+		shape.names.push_back(GetSizedString(dsq));								// Sequence name, then the sequence without its name index
+		sequence.nameIndex = shape.names.size() - 1;
+		parseSequence(version, sequence, dsq, false);
+		RemapNodeKeys(nodeMap, sequence.numKeyframes, sequence.rotationMatters, sequence.baseRotation, nodeRotations, shape.nodeRotations);
+		RemapNodeKeys(nodeMap, sequence.numKeyframes, sequence.translationMatters, sequence.baseTranslation, nodeTranslations, shape.nodeTranslations);
+		// Scale keys are skipped above, so the sequence plays without them
+		if (std::any_of(sequence.scaleMatters.begin(), sequence.scaleMatters.end(), [](uint32_t bits) { return bits != 0; }))
+		{
+			UE_LOG(LogDts, Warning, TEXT("Sequence [%s] animates node scale, which isn't imported from .dsq files"), UTF8_TO_TCHAR(shape.names[sequence.nameIndex].c_str()));
+		}
+		sequence.scaleMatters.clear();
+	}
+
+	int32_t numTriggers = GetValue<int32_t>(dsq);
+	if (!CheckCount(numTriggers, 2 * sizeof(int32_t), dsq))
+	{
+		return false;
+	}
+	shape.triggers.resize(numTriggers);
+	for (FDtsTrigger& trigger : shape.triggers)
+	{
+		trigger.state = GetValue<uint32_t>(dsq);
+		trigger.pos = GetValue<float>(dsq);
+	}
+	return !dsq.hasFailed();
+}
+
+
+bool UDtsFactory::parseMesh(uint32_t version, FDtsMesh& mesh, uint32_t& guardValue, FDtsStream& memBuffer32, FDtsStream& memBuffer16, FDtsStream& memBuffer8)
+{
+
+	uint32_t meshType = GetValue<uint32_t>(memBuffer32);		// Type of mesh
+	mesh.meshType = meshType;
 
 	if (meshType == DTSMeshType::NullMeshType)
 	{
-		return;
+		return true;
 	}
 
-	CheckGuard(guardValue, memBuffer32, sizeMemBuffer32, memBuffer16, sizeMemBuffer16, memBuffer8, sizeMemBuffer8);
+	if (!CheckGuard(guardValue, memBuffer32, memBuffer16, memBuffer8))
+	{
+		return false;
+	}
 
-	int32_t numFrames = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);		// Number of vertex position keyframes
-	int32_t numMatFrames = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);		// Number of vertex UV keyframes
-	int32_t parentMesh = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);		// Index of this mesh's parent (usually -1 for none)
-	FBox bounds = GetBox(memBuffer32, sizeMemBuffer32);							// Bounding box for this mesh
-	FVector center = GetVector(memBuffer32, sizeMemBuffer32);					// Bounds center for this mesh
-	float radius = GetValue<float>(memBuffer32, sizeMemBuffer32);				// Bounding sphere radius for this mesh
-	int32_t numVerts = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);			// Number of vertex positions
-	for (auto i = 0; i < numVerts; i++)											// Array of numVerts vertex positions (all keyframes)
+	mesh.numFrames = GetValue<int32_t>(memBuffer32);			// Number of vertex position keyframes
+	mesh.numMatFrames = GetValue<int32_t>(memBuffer32);			// Number of vertex UV keyframes
+	mesh.parentMesh = GetValue<int32_t>(memBuffer32);			// Index of this mesh's parent (usually -1 for none)
+	mesh.bounds = GetBox(memBuffer32);							// Bounding box for this mesh
+	mesh.center = GetVector(memBuffer32);						// Bounds center for this mesh
+	mesh.radius = GetValue<float>(memBuffer32);					// Bounding sphere radius for this mesh
+	const bool sharedData = mesh.parentMesh >= 0;				// Vertex data of a mesh with a parent is only stored with the parent; counts are still stored
+	int32_t numVerts = GetValue<int32_t>(memBuffer32);			// Number of vertex positions
+	mesh.numVerts = numVerts;
+	int32_t numStoredVerts = sharedData ? 0 : numVerts;
+	if (!CheckCount(numStoredVerts, 6 * sizeof(float), memBuffer32))
 	{
-		FVector vert = GetVector(memBuffer32, sizeMemBuffer32);
+		return false;
 	}
-	int32_t numTVerts = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);		// Number of UV coordinates
-	for (auto i = 0; i < numTVerts; i++)										// Array of numTVerts UV coordinates (all keyframes)
+	mesh.verts.reserve(numStoredVerts);
+	for (auto i = 0; i < numStoredVerts; i++)									// Array of numVerts vertex positions (all keyframes)
 	{
-		float u = GetValue<float>(memBuffer32, sizeMemBuffer32);				// Point2F u
-		float v = GetValue<float>(memBuffer32, sizeMemBuffer32);				// Point2F v
+		mesh.verts.push_back(GetVector(memBuffer32));
+	}
+	int32_t numTVerts = GetValue<int32_t>(memBuffer32);		// Number of UV coordinates
+	mesh.numTVerts = numTVerts;
+	int32_t numStoredTVerts = sharedData ? 0 : numTVerts;
+	if (!CheckCount(numStoredTVerts, 2 * sizeof(float), memBuffer32))
+	{
+		return false;
+	}
+	mesh.tverts.reserve(numStoredTVerts);
+	for (auto i = 0; i < numStoredTVerts; i++)									// Array of numTVerts UV coordinates (all keyframes)
+	{
+		float u = GetValue<float>(memBuffer32);				// Point2F u
+		float v = GetValue<float>(memBuffer32);				// Point2F v
+		mesh.tverts.push_back(FVector2D(u, v));
 	}
 	if (version >= 26)
 	{
-		int32_t numTVerts2 = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);	// Number of 2nd UV coordinates (DTS v26+ only)
-		for (auto i = 0; i < numTVerts2; i++)									// Array of numTVerts2 2nd UV coordinates (DTS v26+ only)
+		int32_t numTVerts2 = GetValue<int32_t>(memBuffer32);	// Number of 2nd UV coordinates (DTS v26+ only)
+		mesh.numTVerts2 = numTVerts2;
+		if (!CheckCount(sharedData ? 0 : numTVerts2, 2 * sizeof(float), memBuffer32))
+		{
+			return false;
+		}
+		for (auto i = 0; !sharedData && i < numTVerts2; i++)					// Array of numTVerts2 2nd UV coordinates (DTS v26+ only)
 		{
-			float u = GetValue<float>(memBuffer32, sizeMemBuffer32);			// Point2F u
-			float v = GetValue<float>(memBuffer32, sizeMemBuffer32);			// Point2F v
+			float u = GetValue<float>(memBuffer32);			// Point2F u
+			float v = GetValue<float>(memBuffer32);			// Point2F v
+			mesh.tverts2.push_back(FVector2D(u, v));
 		}
 
-		int32_t numVColors = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);	// Number of vertex color values (DTS v26+ only)
-		for (auto i = 0; i < numVColors; i++)									// Array of numVColors vertex colors (DTS v26+ only)
+		int32_t numVColors = GetValue<int32_t>(memBuffer32);	// Number of vertex color values (DTS v26+ only)
+		mesh.numColors = numVColors;
+		if (!CheckCount(sharedData ? 0 : numVColors, sizeof(uint32_t), memBuffer32))
+		{
+			return false;
+		}
+		for (auto i = 0; !sharedData && i < numVColors; i++)					// Array of numVColors vertex colors (DTS v26+ only)
 		{
-			uint32_t color = GetValue<uint32_t>(memBuffer32, sizeMemBuffer32);	// ColorI { U8 red, U8 green, U8 blue, U8 alpha }
+			mesh.colors.push_back(GetValue<uint32_t>(memBuffer32));	// ColorI { U8 red, U8 green, U8 blue, U8 alpha }
 		}
 	}
-	for (auto i = 0; i < numVerts; i++)											// Array of numVerts vertex normals
+	mesh.norms.reserve(numStoredVerts);
+	for (auto i = 0; i < numStoredVerts; i++)									// Array of numVerts vertex normals
 	{
-		FVector norm = GetVector(memBuffer32, sizeMemBuffer32);
+		mesh.norms.push_back(GetVector(memBuffer32));
 	}
-	for (auto i = 0; i < numVerts; i++)											// Array of numVerts encoded normal indices
+	mesh.encodedNorms.reserve(numStoredVerts);
+	for (auto i = 0; i < numStoredVerts; i++)									// Array of numVerts encoded normal indices
 	{
-		uint8_t encodedNorm = GetValue<uint8_t>(memBuffer8, sizeMemBuffer8);
+		mesh.encodedNorms.push_back(GetValue<uint8_t>(memBuffer8));
 	}
 
-	int32_t numPrimitives = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);	// Number of mesh primitives (triangles, triangle lists etc)
+	int32_t numPrimitives = GetValue<int32_t>(memBuffer32);	// Number of mesh primitives (triangles, triangle lists etc)
+	if (!(version <= 24 ? CheckCount(numPrimitives, 2 * sizeof(int16_t), memBuffer16) : CheckCount(numPrimitives, 3 * sizeof(int32_t), memBuffer32)))
+	{
+		return false;
+	}
+	mesh.primitives.resize(numPrimitives);
 	if (version <= 24)
 	{
 		for (auto i = 0; i < numPrimitives; i++)								// primitives (v24-) 16-bit S16 Array of numPrimitives 16-bit Primitive struct data { start, numElements }
 		{
-			int16_t start = GetValue<int16_t>(memBuffer16, sizeMemBuffer16);
-			int16_t numElements = GetValue<int16_t>(memBuffer16, sizeMemBuffer16);
+			mesh.primitives[i].start = GetValue<int16_t>(memBuffer16);
+			mesh.primitives[i].numElements = GetValue<int16_t>(memBuffer16);
 		}
-		for (auto i = 0; i < numPrimitives; i++)								// primitives (v24-) 32-bit U32 Array of numPrimitives 32-bit Primitive struct data { maxIndex }
+		for (auto i = 0; i < numPrimitives; i++)								// primitives (v24-) 32-bit U32 Array of numPrimitives 32-bit Primitive struct data { matIndex }
 		{
-			uint32_t maxIndex = GetValue<uint32_t>(memBuffer32, sizeMemBuffer32);
+			mesh.primitives[i].matIndex = GetValue<uint32_t>(memBuffer32);
 		}
 	}
 	else
 	{
 		for (auto i = 0; i < numPrimitives; i++)								// primitives (v25+) 32-bit Primitive { S32 start, S32 numElements, U32 matIndex } Array of numPrimitives Primitives
 		{
-			int32_t start = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
-			int32_t numElements = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
-			uint32_t matIndex = GetValue<uint32_t>(memBuffer32, sizeMemBuffer32);
+			mesh.primitives[i].start = GetValue<int32_t>(memBuffer32);
+			mesh.primitives[i].numElements = GetValue<int32_t>(memBuffer32);
+			mesh.primitives[i].matIndex = GetValue<uint32_t>(memBuffer32);
 		}
 	}
 
-	int32_t numIndices = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);		// Total number of vertex indices (all primitives)
+	int32_t numIndices = GetValue<int32_t>(memBuffer32);		// Total number of vertex indices (all primitives)
+	if (!(version <= 25 ? CheckCount(numIndices, sizeof(int16_t), memBuffer16) : CheckCount(numIndices, sizeof(int32_t), memBuffer32)))
+	{
+		return false;
+	}
+	mesh.indices.reserve(numIndices);
 	if (version <= 25)
 	{
 		for (auto i = 0; i < numIndices; i++)									// indices (DTS v25-) 16-bit S16 Array of numIndices vertex indices
 		{
-			int16_t vertex = GetValue<int16_t>(memBuffer16, sizeMemBuffer16);
+			mesh.indices.push_back(uint16_t(GetValue<int16_t>(memBuffer16)));
 		}
 	}
 	else
 	{
 		for (auto i = 0; i < numIndices; i++)									// indices (DTS v25+) 32-bit S32 Array of numIndices vertex indices
 		{
-			int32_t vertex = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
+			mesh.indices.push_back(GetValue<int32_t>(memBuffer32));
 		}
 	}
 
-	int32_t numMergeIndices = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);	// Number of merge indices. Note that merge indices have been deprecated.
+	int32_t numMergeIndices = GetValue<int32_t>(memBuffer32);	// Number of merge indices. Note that merge indices have been deprecated.
+	if (!CheckCount(numMergeIndices, sizeof(int16_t), memBuffer16))
+	{
+		return false;
+	}
 	for (auto i = 0; i < numMergeIndices; i++)									// Array of numMergeIndices merge indices
 	{
-		int16_t vertex = GetValue<int16_t>(memBuffer16, sizeMemBuffer16);
+		int16_t vertex = GetValue<int16_t>(memBuffer16);
 	}
 
-	int32_t vertsPerFrame = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);	// Number of vertices in each keyframe (position or UV)
-	uint32_t flags = GetValue<uint32_t>(memBuffer32, sizeMemBuffer32);			// Mesh flags
+	mesh.vertsPerFrame = GetValue<int32_t>(memBuffer32);		// Number of vertices in each keyframe (position or UV)
+	mesh.flags = GetValue<uint32_t>(memBuffer32);				// Mesh flags
 
-	CheckGuard(guardValue, memBuffer32, sizeMemBuffer32, memBuffer16, sizeMemBuffer16, memBuffer8, sizeMemBuffer8);
+	if (!CheckGuard(guardValue, memBuffer32, memBuffer16, memBuffer8))
+	{
+		return false;
+	}
 
 	if (meshType == DTSMeshType::SkinMeshType)
 	{
-		int32_t numInitialVerts = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);	// Number of intial vert positions and normals
-		for (auto i = 0; i < numInitialVerts; i++)									// Array of numInitialVerts positions
+		FDtsSkin& skin = mesh.skin;
+		skin.numInitialVerts = GetValue<int32_t>(memBuffer32);	// Number of intial vert positions and normals
+		int32_t numInitialVerts = sharedData ? 0 : skin.numInitialVerts;
+		if (!CheckCount(numInitialVerts, 6 * sizeof(float), memBuffer32))
 		{
-			int32_t initialVert = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
+			return false;
+		}
+		for (auto i = 0; i < numInitialVerts; i++)									// Array of numInitialVerts positions (Point3F)
+		{
+			skin.initialVerts.push_back(GetVector(memBuffer32));
 		}
 		for (auto i = 0; i < numInitialVerts; i++)									// Array of numInitialVerts vertex normals
 		{
-			FVector norm = GetVector(memBuffer32, sizeMemBuffer32);
+			skin.initialNorms.push_back(GetVector(memBuffer32));
 		}
 		for (auto i = 0; i < numInitialVerts; i++)									// Array of numInitialVerts encoded initial normal indices
 		{
-			uint8_t encodedNorm = GetValue<uint8_t>(memBuffer8, sizeMemBuffer8);
+			skin.initialEncodedNorms.push_back(GetValue<uint8_t>(memBuffer8));
 		}
-		int32_t numInitialTransforms = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);	// Number of initial transforms
-		for (auto i = 0; i < numInitialTransforms; i++)									// Array of numInitialTransforms transforms
+		skin.numInitialTransforms = GetValue<int32_t>(memBuffer32);	// Number of initial transforms
+		if (!CheckCount(sharedData ? 0 : skin.numInitialTransforms, 16 * sizeof(float), memBuffer32))
 		{
+			return false;
+		}
+		for (auto i = 0; !sharedData && i < skin.numInitialTransforms; i++)			// Array of numInitialTransforms transforms
+		{
+			FMatrix transform;
 			for (auto n = 0; n < 16; n++)												// MatrixF { F32 m[16] }
 			{
-				float value = GetValue<float>(memBuffer32, sizeMemBuffer32);
+				transform.M[n / 4][n % 4] = GetValue<float>(memBuffer32);
 			}
+			skin.initialTransforms.push_back(transform);
 		}
-		int32_t numVertIndices = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);	// Number of vertex indices
-		for (auto i = 0; i < numVertIndices; i++)									// Array of numVertIndices vertex indices
+		skin.numVertIndices = GetValue<int32_t>(memBuffer32);	// Number of vertex indices
+		if (!CheckCount(sharedData ? 0 : skin.numVertIndices, sizeof(int32_t), memBuffer32))
 		{
-			int32_t vertIndice = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
+			return false;
 		}
-		int32_t numBoneIndices = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);	// Number of bone indices
-		for (auto i = 0; i < numBoneIndices; i++)									// Array of numBoneIndices bone indices
+		for (auto i = 0; !sharedData && i < skin.numVertIndices; i++)				// Array of numVertIndices vertex indices
 		{
-			int32_t boneIndice = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
+			skin.vertIndices.push_back(GetValue<int32_t>(memBuffer32));
 		}
-		int32_t numWeights = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);		// Number of weights
-		for (auto i = 0; i < numWeights; i++)										// Array of numWeights bone weights
+		skin.numBoneIndices = GetValue<int32_t>(memBuffer32);	// Number of bone indices
+		if (!CheckCount(sharedData ? 0 : skin.numBoneIndices, sizeof(int32_t), memBuffer32))
 		{
-			float weight = GetValue<float>(memBuffer32, sizeMemBuffer32);
+			return false;
 		}
-		int32_t numNodeIndices = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);	// Number of node indices
-		for (auto i = 0; i < numNodeIndices; i++)									// Array of node indices
+		for (auto i = 0; !sharedData && i < skin.numBoneIndices; i++)				// Array of numBoneIndices bone indices
 		{
-			int32_t nodeIndice = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
+			skin.boneIndices.push_back(GetValue<int32_t>(memBuffer32));
+		}
+		skin.numWeights = GetValue<int32_t>(memBuffer32);		// Number of weights
+		if (!CheckCount(sharedData ? 0 : skin.numWeights, sizeof(float), memBuffer32))
+		{
+			return false;
+		}
+		for (auto i = 0; !sharedData && i < skin.numWeights; i++)					// Array of numWeights bone weights
+		{
+			skin.weights.push_back(GetValue<float>(memBuffer32));
+		}
+		skin.numNodeIndices = GetValue<int32_t>(memBuffer32);	// Number of node indices
+		if (!CheckCount(sharedData ? 0 : skin.numNodeIndices, sizeof(int32_t), memBuffer32))
+		{
+			return false;
+		}
+		for (auto i = 0; !sharedData && i < skin.numNodeIndices; i++)				// Array of node indices
+		{
+			skin.nodeIndices.push_back(GetValue<int32_t>(memBuffer32));
 		}
 
-		CheckGuard(guardValue, memBuffer32, sizeMemBuffer32, memBuffer16, sizeMemBuffer16, memBuffer8, sizeMemBuffer8);
+		if (!CheckGuard(guardValue, memBuffer32, memBuffer16, memBuffer8))
+		{
+			return false;
+		}
 	}
 
 	if (meshType == DTSMeshType::SortedMeshType)
 	{
 
-		int32_t numClusters = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);		// Number of clusters
+		int32_t numClusters = GetValue<int32_t>(memBuffer32);		// Number of clusters
+		if (!CheckCount(numClusters, 8 * sizeof(int32_t) + 2 * sizeof(float), memBuffer32))
+		{
+			return false;
+		}
+		mesh.clusters.resize(numClusters);
 		for (auto i = 0; i < numClusters; i++)										// Array of numClusters Clusters
 		{
-			int32_t startPrimitive = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
-			int32_t endPrimitive = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
-			FVector norm = GetVector(memBuffer32, sizeMemBuffer32);
-			float k = GetValue<float>(memBuffer32, sizeMemBuffer32);
-			int32_t frontCluster = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
-			int32_t backCluster = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
+			FDtsCluster& cluster = mesh.clusters[i];
+			cluster.startPrimitive = GetValue<int32_t>(memBuffer32);
+			cluster.endPrimitive = GetValue<int32_t>(memBuffer32);
+			cluster.normal = GetVector(memBuffer32);
+			cluster.k = GetValue<float>(memBuffer32);
+			cluster.frontCluster = GetValue<int32_t>(memBuffer32);
+			cluster.backCluster = GetValue<int32_t>(memBuffer32);
+		}
+		int32_t numStartClusters = GetValue<int32_t>(memBuffer32);	// Number of start cluster indices
+		if (!CheckCount(numStartClusters, sizeof(int32_t), memBuffer32))
+		{
+			return false;
 		}
-		int32_t numStartClusters = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);	// Number of start cluster indices
 		for (auto i = 0; i < numStartClusters; i++)									// Array of numStartClusters start cluster indices
 		{
-			int32_t startCluster = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
+			mesh.startClusters.push_back(GetValue<int32_t>(memBuffer32));
+		}
+		int32_t numFirstVerts = GetValue<int32_t>(memBuffer32);	// Number of first vertex indices
+		if (!CheckCount(numFirstVerts, sizeof(int32_t), memBuffer32))
+		{
+			return false;
 		}
-		int32_t numFirstVerts = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);	// Number of first vertex indices
 		for (auto i = 0; i < numFirstVerts; i++)									// Array of numFirstVerts first vertex indices
 		{
-			int32_t firstVert = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
+			mesh.firstVerts.push_back(GetValue<int32_t>(memBuffer32));
+		}
+		int32_t numNumVerts = GetValue<int32_t>(memBuffer32);		// Number of numVert counts
+		if (!CheckCount(numNumVerts, sizeof(int32_t), memBuffer32))
+		{
+			return false;
 		}
-		int32_t numNumVerts = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);		// Number of numVert counts
 		for (auto i = 0; i < numNumVerts; i++)										// Array of numVert counts
 		{
-			int32_t count = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
+			mesh.clusterNumVerts.push_back(GetValue<int32_t>(memBuffer32));
+		}
+		int32_t numFirstTVerts = GetValue<int32_t>(memBuffer32);	// Number of first TVert indices
+		if (!CheckCount(numFirstTVerts, sizeof(int32_t), memBuffer32))
+		{
+			return false;
 		}
-		int32_t numFirstTVerts = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);	// Number of first TVert indices
 		for (auto i = 0; i < numFirstTVerts; i++)									// Array of numFIrstTVerts first TVert indices
 		{
-			int32_t firstTVert = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);
+			mesh.firstTVerts.push_back(GetValue<int32_t>(memBuffer32));
 		}
-		int32_t alwaysWriteDepth = GetValue<int32_t>(memBuffer32, sizeMemBuffer32);	// Always write depth flag
+		mesh.alwaysWriteDepth = GetValue<int32_t>(memBuffer32) != 0;	// Always write depth flag
 
-		CheckGuard(guardValue, memBuffer32, sizeMemBuffer32, memBuffer16, sizeMemBuffer16, memBuffer8, sizeMemBuffer8);
+		if (!CheckGuard(guardValue, memBuffer32, memBuffer16, memBuffer8))
+		{
+			return false;
+		}
 	}
+	return !memBuffer32.hasFailed() && !memBuffer16.hasFailed() && !memBuffer8.hasFailed();
 }
 
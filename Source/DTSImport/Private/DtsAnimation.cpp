@@ -0,0 +1,333 @@
+
+
+#include "DtsAnimation.h"
+#include "DtsBuild.h"
+#include "DtsFactory.h"
+#include "DtsShape.h"
+
+#include "Animation/AnimSequence.h"
+#include "Animation/Skeleton.h"
+#include "AssetRegistryModule.h"
+#include "Async/ParallelFor.h"
+#include "Misc/PackageName.h"
+#include "ObjectTools.h"
+#include "UObject/Package.h"
+
+
+namespace
+{
+
+// Quaternion pairs and weights for a batch of frames, kept as one array per component
+struct FDtsQuatBatch
+{
+	TArray<float> q[8];			// x0 y0 z0 w0 x1 y1 z1 w1
+	TArray<float> alpha;
+
+	explicit FDtsQuatBatch(int32 num)
+	{
+		for (TArray<float>& component : q)
+		{
+			component.SetNumUninitialized(num);
+		}
+		alpha.SetNumUninitialized(num);
+	}
+
+	void set(int32 i, const FQuat& q0, const FQuat& q1, float weight)
+	{
+		q[0][i] = q0.X; q[1][i] = q0.Y; q[2][i] = q0.Z; q[3][i] = q0.W;
+		q[4][i] = q1.X; q[5][i] = q1.Y; q[6][i] = q1.Z; q[7][i] = q1.W;
+		alpha[i] = weight;
+	}
+
+	// Slerp along the shorter arc, approximated by a normalized lerp whose weight is corrected by a cubic in the
+	// ends' dot product (error under 1e-3 rad). No transcendentals or branches, so the loop vectorizes
+	void slerp(TArray<FQuat>& out) const
+	{
+		const int32 num = alpha.Num();
+		out.SetNumUninitialized(num);
+		const float* RESTRICT x0 = q[0].GetData(); const float* RESTRICT y0 = q[1].GetData(); const float* RESTRICT z0 = q[2].GetData(); const float* RESTRICT w0 = q[3].GetData();
+		const float* RESTRICT x1 = q[4].GetData(); const float* RESTRICT y1 = q[5].GetData(); const float* RESTRICT z1 = q[6].GetData(); const float* RESTRICT w1 = q[7].GetData();
+		const float* RESTRICT t = alpha.GetData();
+		FQuat* RESTRICT result = out.GetData();
+		for (auto i = 0; i < num; i++)
+		{
+			const float cosTheta = x0[i] * x1[i] + y0[i] * y1[i] + z0[i] * z1[i] + w0[i] * w1[i];
+			const float d = FMath::Abs(cosTheta);
+			const float a = 1.0904f + d * (-3.2452f + d * (3.55645f - d * 1.43519f));
+			const float b = 0.848013f + d * (-1.06021f + d * 0.215638f);
+			const float h = t[i] - 0.5f;
+			const float k = a * h * h + b;
+			const float u = t[i] + t[i] * h * (t[i] - 1.0f) * k;
+			const float s0 = 1.0f - u;
+			const float s1 = cosTheta < 0.0f ? -u : u;
+			const float x = s0 * x0[i] + s1 * x1[i];
+			const float y = s0 * y0[i] + s1 * y1[i];
+			const float z = s0 * z0[i] + s1 * z1[i];
+			const float w = s0 * w0[i] + s1 * w1[i];
+			const float scale = FMath::InvSqrt(x * x + y * y + z * z + w * w);
+			result[i] = FQuat(x * scale, y * scale, z * scale, w * scale);
+		}
+	}
+};
+
+
+// Keyframe interval of every output frame. Cyclic sequences wrap from the last keyframe to the first
+struct FDtsFrameKeys
+{
+	TArray<int32> key0;
+	TArray<int32> key1;
+	TArray<float> alpha;
+
+	FDtsFrameKeys(const FDtsSequence& sequence, int32 numFrames)
+	{
+		key0.SetNumUninitialized(numFrames);
+		key1.SetNumUninitialized(numFrames);
+		alpha.SetNumUninitialized(numFrames);
+		const int32 numKeys = FMath::Max(sequence.numKeyframes, 1);
+		const bool cyclic = (sequence.flags & SequenceCyclic) != 0;
+		for (auto i = 0; i < numFrames; i++)
+		{
+			const float position = numFrames > 1 ? float(i) / float(numFrames - 1) : 0.0f;
+			const float key = position * float(cyclic ? numKeys : numKeys - 1);
+			key0[i] = FMath::Clamp(int32(key), 0, numKeys - 1);
+			key1[i] = cyclic ? (key0[i] + 1) % numKeys : FMath::Min(key0[i] + 1, numKeys - 1);
+			alpha[i] = FMath::Clamp(key - float(key0[i]), 0.0f, 1.0f);
+		}
+	}
+};
+
+
+bool IsBitSet(const std::vector<uint32_t>& bits, int32 index)
+{
+	return index / 32 < int32(bits.size()) && (bits[index / 32] & (1u << (index % 32))) != 0;
+}
+
+}
+
+
+void DtsSampleGround(const FDtsShape& shape, const FDtsSequence& sequence, int32 numFrames, TArray<FVector>& translations, TArray<FQuat>& rotations)
+{
+	translations.SetNumUninitialized(numFrames);
+	const int32 numKeys = sequence.numGroundFrames;
+	const int32 firstKey = sequence.firstGroundFrame;
+	if (numKeys <= 0 || firstKey < 0 || firstKey + numKeys > int32(shape.groundTranslations.size()) || firstKey + numKeys > int32(shape.groundRotations.size()))
+	{
+		rotations.SetNumUninitialized(numFrames);
+		for (auto i = 0; i < numFrames; i++)
+		{
+			translations[i] = FVector::ZeroVector;
+			rotations[i] = FQuat::Identity;
+		}
+		return;
+	}
+
+	FDtsQuatBatch batch(numFrames);
+	for (auto i = 0; i < numFrames; i++)
+	{
+		// Torque scales by 0.9999 so position 1 still falls in the last interval
+		const float position = numFrames > 1 ? float(i) / float(numFrames - 1) : 0.0f;
+		const float key = position * 0.9999f * float(numKeys);
+		const int32 frame = FMath::Clamp(int32(key), 0, numKeys - 1);
+		const float alpha = key - float(frame);
+		batch.set(i, frame > 0 ? shape.groundRotations[firstKey + frame - 1] : FQuat::Identity, shape.groundRotations[firstKey + frame], alpha);
+		const FVector& p0 = frame > 0 ? shape.groundTranslations[firstKey + frame - 1] : FVector::ZeroVector;
+		const FVector& p1 = shape.groundTranslations[firstKey + frame];
+		translations[i] = p0 + (p1 - p0) * alpha;
+	}
+	batch.slerp(rotations);
+}
+
+
+void DtsSampleNodes(const FDtsShape& shape, const FDtsSequence& sequence, int32 numFrames, TArray<int32>& nodes, TArray<TArray<FTransform>>& transforms)
+{
+	const FDtsFrameKeys frames(sequence, numFrames);
+	const int32 numKeys = sequence.numKeyframes;
+	int32 rotationKey = sequence.baseRotation;
+	int32 translationKey = sequence.baseTranslation;
+	FDtsQuatBatch batch(numFrames);
+	TArray<FQuat> rotations;
+	for (auto node = 0; node < int32(shape.nodes.size()); node++)
+	{
+		const bool rotationAnimated = IsBitSet(sequence.rotationMatters, node);
+		const bool translationAnimated = IsBitSet(sequence.translationMatters, node);
+		if (!rotationAnimated && !translationAnimated)
+		{
+			continue;
+		}
+		const FDtsNode& defaults = shape.nodes[node];
+		TArray<FTransform>& track = transforms.AddDefaulted_GetRef();
+		track.SetNumUninitialized(numFrames);
+		nodes.Add(node);
+
+		const bool hasRotations = rotationAnimated && rotationKey >= 0 && rotationKey + numKeys <= int32(shape.nodeRotations.size());
+		if (hasRotations)
+		{
+			const FQuat* keys = shape.nodeRotations.data() + rotationKey;
+			for (auto i = 0; i < numFrames; i++)
+			{
+				batch.set(i, keys[frames.key0[i]], keys[frames.key1[i]], frames.alpha[i]);
+			}
+			batch.slerp(rotations);
+		}
+		const bool hasTranslations = translationAnimated && translationKey >= 0 && translationKey + numKeys <= int32(shape.nodeTranslations.size());
+		const FVector* translations = hasTranslations ? shape.nodeTranslations.data() + translationKey : nullptr;
+		for (auto i = 0; i < numFrames; i++)
+		{
+			const FQuat rotation = hasRotations ? rotations[i] : defaults.defaultRotation;
+			const FVector translation = translations ? FMath::Lerp(translations[frames.key0[i]], translations[frames.key1[i]], frames.alpha[i]) : defaults.defaultTranslation;
+			track[i] = FTransform(rotation.Inverse(), translation);
+		}
+		rotationKey += rotationAnimated ? numKeys : 0;
+		translationKey += translationAnimated ? numKeys : 0;
+	}
+}
+
+
+TArray<UAnimSequence*> UDtsFactory::buildAnimSequences(const FDtsShape& shape, UObject* InParent, FName Name, EObjectFlags Flags, bool bFirstInParent)
+{
+	TArray<UAnimSequence*> animSequences;
+	if (shape.sequences.empty())
+	{
+		return animSequences;
+	}
+	USkeleton* skeleton = Cast<USkeleton>(Skeleton.TryLoad());
+	if (!skeleton || skeleton->GetReferenceSkeleton().GetRawBoneNum() == 0)
+	{
+		UE_LOG(LogDts, Warning, TEXT("Skipping %d sequences of [%s]: no Skeleton to animate"), int32(shape.sequences.size()), *Name.ToString());
+		return animSequences;
+	}
+	const FReferenceSkeleton& referenceSkeleton = skeleton->GetReferenceSkeleton();
+	const FTransform rootPose = referenceSkeleton.GetRefBonePose()[0];
+	const float sampleRate = FMath::Max(AnimSampleRate, 1.0f);
+
+	// Nodes drive the bones of the same name
+	TArray<int32> boneForNode;
+	for (const FDtsNode& node : shape.nodes)
+	{
+		boneForNode.Add(referenceSkeleton.FindBoneIndex(FName(UTF8_TO_TCHAR(shape.getName(node.nameIndex).c_str()))));
+	}
+
+	// Resample every sequence first, on worker threads; asset creation stays on this thread
+	struct FSequenceTracks
+	{
+		int32 numFrames = 0;
+		TArray<int32> bones;
+		TArray<FRawAnimSequenceTrack> tracks;
+	};
+	const int32 numSequences = shape.sequences.size();
+	TArray<FSequenceTracks> sequenceTracks;
+	sequenceTracks.SetNum(numSequences);
+	ParallelFor(numSequences, [&](int32 s)
+	{
+		const FDtsSequence& sequence = shape.sequences[s];
+		FSequenceTracks& result = sequenceTracks[s];
+		const int32 numFrames = FMath::Max(2, FMath::RoundToInt(FMath::Max(sequence.duration, 0.0f) * sampleRate) + 1);
+		result.numFrames = numFrames;
+		auto addTrack = [&result, numFrames](int32 bone) -> FRawAnimSequenceTrack&
+		{
+			result.bones.Add(bone);
+			FRawAnimSequenceTrack& track = result.tracks.AddDefaulted_GetRef();
+			track.PosKeys.SetNumUninitialized(numFrames);
+			track.RotKeys.SetNumUninitialized(numFrames);
+			track.ScaleKeys.SetNumUninitialized(numFrames);
+			return track;
+		};
+		auto setKey = [](FRawAnimSequenceTrack& track, int32 i, const FTransform& key)
+		{
+			track.PosKeys[i] = key.GetTranslation();
+			track.RotKeys[i] = key.GetRotation();
+			track.ScaleKeys[i] = key.GetScale3D();
+		};
+
+		TArray<int32> nodes;
+		TArray<TArray<FTransform>> nodeTransforms;
+		DtsSampleNodes(shape, sequence, numFrames, nodes, nodeTransforms);
+		const TArray<FTransform>* rootTransforms = nullptr;
+		for (auto n = 0; n < nodes.Num(); n++)
+		{
+			const int32 bone = boneForNode[nodes[n]];
+			if (bone == 0)
+			{
+				rootTransforms = &nodeTransforms[n];
+			}
+			else if (bone > 0)
+			{
+				FRawAnimSequenceTrack& track = addTrack(bone);
+				for (auto i = 0; i < numFrames; i++)
+				{
+					setKey(track, i, ToUnrealTransform(nodeTransforms[n][i], ImportScale));
+				}
+			}
+		}
+
+		// Ground frames move the root bone (on top of its own animation, if any)
+		if (sequence.numGroundFrames > 0 || rootTransforms)
+		{
+			TArray<FVector> translations;
+			TArray<FQuat> rotations;
+			DtsSampleGround(shape, sequence, numFrames, translations, rotations);
+			FRawAnimSequenceTrack& track = addTrack(0);
+			for (auto i = 0; i < numFrames; i++)
+			{
+				const FTransform local = rootTransforms ? ToUnrealTransform((*rootTransforms)[i], ImportScale) : rootPose;
+				setKey(track, i, local * ToUnrealTransform(FTransform(rotations[i].Inverse(), translations[i]), ImportScale));
+			}
+		}
+	});
+
+	const FString destinationPath = FPackageName::GetLongPackagePath(InParent->GetOutermost()->GetName());
+	for (auto s = 0; s < numSequences; s++)
+	{
+		const FDtsSequence& sequence = shape.sequences[s];
+		const FString sequenceName = UTF8_TO_TCHAR(shape.getName(sequence.nameIndex).c_str());
+		UObject* outer = InParent;
+		FString assetName = Name.ToString();
+		if (s > 0 || !bFirstInParent)
+		{
+			assetName = ObjectTools::SanitizeObjectName(Name.ToString() + TEXT("_") + (sequenceName.IsEmpty() ? FString::FromInt(s) : sequenceName));
+			outer = CreatePackage(nullptr, *(destinationPath / assetName));
+		}
+		UAnimSequence* animSequence = NewObject<UAnimSequence>(outer, FName(*assetName), Flags | RF_Public | RF_Standalone);
+		animSequence->SetSkeleton(skeleton);
+		animSequence->SequenceLength = FMath::Max(sequence.duration, MINIMUM_ANIMATION_LENGTH);
+		animSequence->SetRawNumberOfFrame(sequenceTracks[s].numFrames);
+		for (auto t = 0; t < sequenceTracks[s].tracks.Num(); t++)
+		{
+			animSequence->AddNewRawTrack(referenceSkeleton.GetBoneName(sequenceTracks[s].bones[t]), &sequenceTracks[s].tracks[t]);
+		}
+		animSequence->bEnableRootMotion = sequence.numGroundFrames > 0;
+		animSequence->RootMotionRootLock = ERootMotionRootLock::RefPose;
+
+		// Triggers become notifies named after their number and state, e.g. DtsTrigger3On.
+		// Torque stores trigger n as the bit 1 << (n - 1)
+		for (auto t = sequence.firstTrigger; t < sequence.firstTrigger + sequence.numTriggers; t++)
+		{
+			if (t < 0 || t >= int32(shape.triggers.size()) || (shape.triggers[t].state & TriggerStateMask) == 0)
+			{
+				continue;
+			}
+			const FDtsTrigger& trigger = shape.triggers[t];
+			const uint32 triggerNumber = FMath::FloorLog2(trigger.state & TriggerStateMask) + 1;
+			const FName notifyName(*FString::Printf(TEXT("DtsTrigger%u%s"), triggerNumber, (trigger.state & TriggerStateOn) ? TEXT("On") : TEXT("Off")));
+			const float time = FMath::Clamp(trigger.pos, 0.0f, 1.0f) * animSequence->SequenceLength;
+			FAnimNotifyEvent& notify = animSequence->Notifies.AddDefaulted_GetRef();
+			notify.NotifyName = notifyName;
+			notify.Link(animSequence, time);
+			notify.TriggerTimeOffset = GetTriggerTimeOffsetForType(animSequence->CalculateOffsetForNotify(time));
+			if (!skeleton->AnimationNotifies.Contains(notifyName))
+			{
+				skeleton->AnimationNotifies.Add(notifyName);
+				skeleton->MarkPackageDirty();
+			}
+		}
+
+		animSequence->MarkRawDataAsModified();
+		animSequence->OnRawDataChanged();
+		animSequence->RefreshCacheData();
+		animSequence->PostEditChange();
+		FAssetRegistryModule::AssetCreated(animSequence);
+		outer->MarkPackageDirty();
+		animSequences.Add(animSequence);
+	}
+	return animSequences;
+}
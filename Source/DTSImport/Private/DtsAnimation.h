@@ -0,0 +1,18 @@
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FDtsShape;
+struct FDtsSequence;
+
+
+// Ground transforms of a sequence at numFrames evenly spaced positions over [0, 1], in DTS space. As in Torque's
+// TSThread::getGround, the sequence's N ground keys sit at positions 1/N ... N/N and position 0 is the identity.
+// Keys are gathered for all frames first, then interpolated in one pass over flat arrays.
+void DtsSampleGround(const FDtsShape& shape, const FDtsSequence& sequence, int32 numFrames, TArray<FVector>& translations, TArray<FQuat>& rotations);
+
+// Local transform of every node a sequence animates, at numFrames evenly spaced positions, in DTS space.
+// Channels the sequence doesn't animate keep the node's default. nodes is sorted by node index.
+void DtsSampleNodes(const FDtsShape& shape, const FDtsSequence& sequence, int32 numFrames, TArray<int32>& nodes, TArray<TArray<FTransform>>& transforms);
@@ -0,0 +1,360 @@
+
+
+#include "DtsBenchCommandlet.h"
+#include "DtsBuild.h"
+#include "DtsImposter.h"
+#include "DtsQuantize.h"
+#include "DtsShape.h"
+#include "DtsSortedMesh.h"
+#include "DtsTangents.h"
+#include "DtsWriter.h"
+#include "DtsFactory.h"
+
+#include "HAL/FileManager.h"
+#include "MeshDescription.h"
+#include "MeshDescriptionOperations.h"
+#include "StaticMeshAttributes.h"
+
+
+UDtsBenchCommandlet::UDtsBenchCommandlet(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+
+// Seconds spent by the reference and by the optimized version of one stage, summed over all files
+struct FDtsBenchTimer
+{
+	double referenceSeconds = 0.0;
+	double optimizedSeconds = 0.0;
+	int64 runs = 0;
+	int32 mismatches = 0;
+
+	void log(const TCHAR* stage, const TCHAR* reference, const TCHAR* optimized) const
+	{
+		if (runs == 0)
+		{
+			UE_LOG(LogDts, Display, TEXT("%s: nothing to measure"), stage);
+			return;
+		}
+		UE_LOG(LogDts, Display, TEXT("%s: %s %.3f us, %s %.3f us per run (%.2fx) over %lld runs, %d mismatches"), stage,
+			reference, referenceSeconds * 1e6 / runs, optimized, optimizedSeconds * 1e6 / runs,
+			optimizedSeconds > 0.0 ? referenceSeconds / optimizedSeconds : 0.0, runs, mismatches);
+	}
+};
+
+
+// Torque's walk: chase frontCluster/backCluster through the cluster array as stored in the file
+static void WalkClusters(const FDtsMesh& mesh, const FVector& cameraPosition, TArray<int32>& primitiveOrder)
+{
+	primitiveOrder.Reset();
+	const int32 numClusters = mesh.clusters.size();
+	const int32 numPrimitives = mesh.primitives.size();
+	int32 cluster = mesh.startClusters.empty() ? -1 : mesh.startClusters[0];
+	for (int32 steps = 0; cluster >= 0 && cluster < numClusters && steps < numClusters; steps++)
+	{
+		const FDtsCluster& node = mesh.clusters[cluster];
+		for (auto i = FMath::Clamp(node.startPrimitive, 0, numPrimitives); i < FMath::Clamp(node.endPrimitive, 0, numPrimitives); i++)
+		{
+			primitiveOrder.Add(i);
+		}
+		cluster = FVector::DotProduct(node.normal, cameraPosition) > node.k ? node.frontCluster : node.backCluster;
+	}
+}
+
+
+// Sorted mesh draw order: the file's cluster array against the flattened tree, from each view octant
+static void BenchSortedMeshes(const FDtsShape& shape, int32 iterations, FDtsBenchTimer& timer)
+{
+	TArray<int32> reference;
+	TArray<int32> optimized;
+	for (const FDtsMesh& mesh : shape.meshes)
+	{
+		if (mesh.meshType != SortedMeshType || mesh.clusters.empty())
+		{
+			continue;
+		}
+		FDtsClusterTree tree(mesh);
+		const float distance = FMath::Max(mesh.radius, 1.0f) * 10.0f;
+		for (auto octant = 0; octant < 8; octant++)
+		{
+			const FVector direction((octant & 1) ? 1.0f : -1.0f, (octant & 2) ? 1.0f : -1.0f, (octant & 4) ? 1.0f : -1.0f);
+			const FVector cameraPosition = mesh.center + direction.GetUnsafeNormal() * distance;
+
+			double startTime = FPlatformTime::Seconds();
+			for (auto i = 0; i < iterations; i++)
+			{
+				WalkClusters(mesh, cameraPosition, reference);
+			}
+			timer.referenceSeconds += FPlatformTime::Seconds() - startTime;
+
+			startTime = FPlatformTime::Seconds();
+			for (auto i = 0; i < iterations; i++)
+			{
+				tree.getOctantOrder(mesh.center, mesh.radius, octant, optimized);
+			}
+			timer.optimizedSeconds += FPlatformTime::Seconds() - startTime;
+
+			timer.runs += iterations;
+			timer.mismatches += reference != optimized ? 1 : 0;
+		}
+	}
+}
+
+
+// Generated tangents against the engine's MikkTSpace build of the same triangles and normals
+struct FDtsTangentBench
+{
+	FDtsBenchTimer timer;			// Mismatches count bitangent signs that differ from the engine's
+	int64 numInstances = 0;
+	float maxAngleDegrees = 0.0f;
+	double sumAngleDegrees = 0.0;
+};
+
+
+static void BenchTangents(const FDtsShape& shape, FDtsTangentBench& bench)
+{
+	for (auto meshIndex = 0; meshIndex < int32(shape.meshes.size()); meshIndex++)
+	{
+		const FDtsMesh& mesh = shape.meshes[meshIndex];
+		const FDtsMesh& vertexData = shape.getVertexData(meshIndex);
+		const int32 numVerts = FMath::Min<int32>(mesh.vertsPerFrame > 0 ? mesh.vertsPerFrame : vertexData.verts.size(), vertexData.verts.size());
+		if (mesh.meshType == NullMeshType || mesh.meshType == DecalMeshType || mesh.instanceOf >= 0 || numVerts == 0 || int32(vertexData.tverts.size()) < numVerts)
+		{
+			continue;
+		}
+		TMap<int32, TArray<int32>> trianglesByMaterial;
+		DtsTriangulate(mesh, trianglesByMaterial);
+		TArray<const TArray<int32>*> triangles;
+		for (const auto& pair : trianglesByMaterial)
+		{
+			triangles.Add(&pair.Value);
+		}
+
+		TArray<FVector> normals;
+		TArray<FVector4> tangents;
+		TArray<FVector4> mirroredTangents;
+		double startTime = FPlatformTime::Seconds();
+		DtsComputeTangents(vertexData.verts.data(), vertexData.tverts.data(), numVerts, triangles, normals, tangents, mirroredTangents);
+		bench.timer.optimizedSeconds += FPlatformTime::Seconds() - startTime;
+
+		// Same topology as the import: one instance per vertex and handedness used, holding the generated normal
+		FMeshDescription meshDescription;
+		FStaticMeshAttributes attributes(meshDescription);
+		attributes.Register();
+		TVertexAttributesRef<FVector> positions = attributes.GetVertexPositions();
+		TVertexInstanceAttributesRef<FVector> instanceNormals = attributes.GetVertexInstanceNormals();
+		TVertexInstanceAttributesRef<FVector2D> instanceUVs = attributes.GetVertexInstanceUVs();
+		TArray<FVertexID> vertices;
+		for (auto i = 0; i < numVerts; i++)
+		{
+			vertices.Add(meshDescription.CreateVertex());
+			positions[vertices[i]] = vertexData.verts[i];
+		}
+		TArray<FVertexInstanceID> instances;
+		instances.Init(FVertexInstanceID::Invalid, numVerts * 2);
+		TArray<TPair<FVertexInstanceID, FVector4>> expected;
+		const FPolygonGroupID group = meshDescription.CreatePolygonGroup();
+		for (const TArray<int32>* list : triangles)
+		{
+			for (auto i = 0; i + 2 < list->Num(); i += 3)
+			{
+				const int32* triangle = list->GetData() + i;
+				if (triangle[0] >= numVerts || triangle[1] >= numVerts || triangle[2] >= numVerts)
+				{
+					continue;
+				}
+				const bool mirrored = mirroredTangents.Num() > 0 && DtsIsMirroredUV(vertexData.tverts[triangle[0]], vertexData.tverts[triangle[1]], vertexData.tverts[triangle[2]]);
+				TArray<FVertexInstanceID> polygon;
+				for (auto c = 0; c < 3; c++)
+				{
+					FVertexInstanceID& instanceID = instances[triangle[c] * 2 + (mirrored ? 1 : 0)];
+					if (instanceID == FVertexInstanceID::Invalid)
+					{
+						instanceID = meshDescription.CreateVertexInstance(vertices[triangle[c]]);
+						instanceNormals[instanceID] = normals[triangle[c]];
+						instanceUVs.Set(instanceID, 0, vertexData.tverts[triangle[c]]);
+						expected.Add(TPair<FVertexInstanceID, FVector4>(instanceID, (mirrored ? mirroredTangents : tangents)[triangle[c]]));
+					}
+					polygon.Add(instanceID);
+				}
+				meshDescription.CreatePolygon(group, polygon);
+			}
+		}
+
+		startTime = FPlatformTime::Seconds();
+		FMeshDescriptionOperations::ComputeMikktTangents(meshDescription, FMeshDescriptionOperations::ETangentOptions::BlendOverlappingNormals);
+		bench.timer.referenceSeconds += FPlatformTime::Seconds() - startTime;
+		bench.timer.runs++;
+
+		TVertexInstanceAttributesRef<FVector> engineTangents = attributes.GetVertexInstanceTangents();
+		TVertexInstanceAttributesRef<float> engineSigns = attributes.GetVertexInstanceBinormalSigns();
+		for (const auto& pair : expected)
+		{
+			const float cosine = FVector::DotProduct(FVector(pair.Value).GetSafeNormal(), engineTangents[pair.Key].GetSafeNormal());
+			const float angle = FMath::RadiansToDegrees(FMath::Acos(FMath::Clamp(cosine, -1.0f, 1.0f)));
+			bench.maxAngleDegrees = FMath::Max(bench.maxAngleDegrees, angle);
+			bench.sumAngleDegrees += angle;
+			bench.timer.mismatches += (pair.Value.W < 0.0f) != (engineSigns[pair.Key] < 0.0f) ? 1 : 0;
+			bench.numInstances++;
+		}
+	}
+}
+
+
+// Cost of the vertex precision check and the vertex bytes it adds over the engine's default formats
+struct FDtsPrecisionBench
+{
+	double seconds = 0.0;
+	int64 numVerts = 0;
+	int32 numMeshes = 0;
+	int32 numRaised = 0;
+	int64 bytesDefault = 0;
+	int64 bytesChosen = 0;
+};
+
+
+static void BenchVertexPrecision(const FDtsShape& shape, FDtsPrecisionBench& bench)
+{
+	FDtsShape copy = shape;
+	TArray<FDtsQuantizeReport> reports;
+	const double startTime = FPlatformTime::Seconds();
+	DtsQuantizeShape(copy, FDtsQuantizeSettings(), reports);
+	bench.seconds += FPlatformTime::Seconds() - startTime;
+	for (const FDtsQuantizeReport& report : reports)
+	{
+		bench.numVerts += report.numVerts;
+		bench.numMeshes++;
+		bench.numRaised += report.halfUVs && report.packedNormals ? 0 : 1;
+		bench.bytesDefault += report.bytesDefault;
+		bench.bytesChosen += report.bytesChosen;
+	}
+}
+
+
+// Optimize pass and writer throughput, on a copy of each shape
+struct FDtsWriteBench
+{
+	double optimizeSeconds = 0.0;
+	double writeSeconds = 0.0;
+	int64 bytesWritten = 0;
+	int32 numShapes = 0;
+};
+
+
+static void BenchWrite(const FDtsShape& shape, int32 iterations, FDtsWriteBench& bench)
+{
+	FDtsShape copy = shape;
+	FDtsOptimizeStats stats;
+	double startTime = FPlatformTime::Seconds();
+	DtsOptimizeShape(copy, stats);
+	bench.optimizeSeconds += FPlatformTime::Seconds() - startTime;
+
+	TArray<uint8> buffer;
+	startTime = FPlatformTime::Seconds();
+	for (auto i = 0; i < iterations; i++)
+	{
+		bench.bytesWritten += DtsWriteShape(copy, buffer);
+	}
+	bench.writeSeconds += FPlatformTime::Seconds() - startTime;
+	bench.numShapes++;
+}
+
+
+// Imposter rendering of each billboard detail level, with untextured materials
+struct FDtsImposterBench
+{
+	double seconds = 0.0;
+	int32 numViews = 0;
+	int64 numPixels = 0;
+};
+
+
+static void BenchImposters(const FDtsShape& shape, FDtsImposterBench& bench)
+{
+	TArray<FDtsImposterTexture> textures;
+	textures.SetNum(shape.materials.size());
+	for (const FDtsDetail& detail : shape.details)
+	{
+		if (shape.version < 26 || detail.subShapeNum >= 0 || detail.size < 0.0f)
+		{
+			continue;
+		}
+		FDtsImposterAtlas atlas;
+		const double startTime = FPlatformTime::Seconds();
+		if (DtsRenderImposters(shape, detail, textures, 0, atlas))
+		{
+			bench.seconds += FPlatformTime::Seconds() - startTime;
+			bench.numViews += atlas.viewDirections.Num();
+			bench.numPixels += int64(atlas.viewDirections.Num()) * atlas.tileSize * atlas.tileSize;
+		}
+	}
+}
+
+
+int32 UDtsBenchCommandlet::Main(const FString& Params)
+{
+	TArray<FString> Tokens;
+	TArray<FString> Switches;
+	TMap<FString, FString> ParamsMap;
+	ParseCommandLine(*Params, Tokens, Switches, ParamsMap);
+
+	const FString* In = ParamsMap.Find(TEXT("In"));
+	if (!In)
+	{
+		UE_LOG(LogDts, Error, TEXT("Usage: -run=DtsBench -In=<file.dts|folder> [-Iterations=<n>]"));
+		return 1;
+	}
+	const FString* IterationsParam = ParamsMap.Find(TEXT("Iterations"));
+	const int32 Iterations = FMath::Max(IterationsParam ? FCString::Atoi(**IterationsParam) : 100, 1);
+
+	TArray<FString> Files;
+	if (IFileManager::Get().DirectoryExists(**In))
+	{
+		IFileManager::Get().FindFilesRecursive(Files, **In, TEXT("*.dts"), true, false);
+	}
+	else
+	{
+		Files.Add(*In);
+	}
+
+	UDtsFactory* Factory = NewObject<UDtsFactory>();
+	int32 NumFailed = 0;
+	FDtsBenchTimer SortedMeshes;
+	FDtsPrecisionBench Precision;
+	FDtsTangentBench Tangents;
+	FDtsWriteBench Write;
+	FDtsImposterBench Imposters;
+	for (const FString& File : Files)
+	{
+		FDtsShape Shape;
+		if (!Factory->readShapeFile(Shape, File))
+		{
+			NumFailed++;
+			continue;
+		}
+		BenchSortedMeshes(Shape, Iterations, SortedMeshes);
+		BenchVertexPrecision(Shape, Precision);
+		BenchTangents(Shape, Tangents);
+		BenchWrite(Shape, Iterations, Write);
+		BenchImposters(Shape, Imposters);
+	}
+
+	UE_LOG(LogDts, Display, TEXT("Benchmarked %d files (%d failed), %d iterations"), Files.Num(), NumFailed, Iterations);
+	SortedMeshes.log(TEXT("Sorted mesh draw order"), TEXT("cluster array walk"), TEXT("flattened tree"));
+	Tangents.timer.log(TEXT("Tangents per mesh"), TEXT("engine MikkTSpace"), TEXT("DtsComputeTangents"));
+	UE_LOG(LogDts, Display, TEXT("Tangents: %lld vertex instances, mean %.3f deg and max %.3f deg from the engine's tangents"),
+		Tangents.numInstances, Tangents.numInstances > 0 ? Tangents.sumAngleDegrees / Tangents.numInstances : 0.0, Tangents.maxAngleDegrees);
+	UE_LOG(LogDts, Display, TEXT("Write: optimize pass %.3f ms per shape, %lld bytes written in %.3f ms (%.1f MB/s)"),
+		Write.numShapes > 0 ? Write.optimizeSeconds * 1000.0 / Write.numShapes : 0.0, Write.bytesWritten, Write.writeSeconds * 1000.0,
+		Write.writeSeconds > 0.0 ? Write.bytesWritten / (1024.0 * 1024.0) / Write.writeSeconds : 0.0);
+	UE_LOG(LogDts, Display, TEXT("Imposters: %d views, %lld pixels in %.3f ms (%.3f ms per view)"), Imposters.numViews, Imposters.numPixels,
+		Imposters.seconds * 1000.0, Imposters.numViews > 0 ? Imposters.seconds * 1000.0 / Imposters.numViews : 0.0);
+	UE_LOG(LogDts, Display, TEXT("Vertex precision check: %lld verts in %.3f ms, %d of %d meshes raised above the default formats, %lld vertex bytes over the engine default"),
+		Precision.numVerts, Precision.seconds * 1000.0, Precision.numRaised, Precision.numMeshes, Precision.bytesChosen - Precision.bytesDefault);
+	return NumFailed > 0 || SortedMeshes.mismatches > 0 ? 1 : 0;
+}
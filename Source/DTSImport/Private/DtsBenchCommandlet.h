@@ -0,0 +1,20 @@
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "DtsBenchCommandlet.generated.h"
+
+
+// Times the import stages that have a simpler reference implementation against that reference, on real files.
+// Usage: -run=DtsBench -In=<file.dts|folder> [-Iterations=<n>]
+UCLASS()
+class UDtsBenchCommandlet : public UCommandlet
+{
+	GENERATED_UCLASS_BODY()
+
+	//~ Begin UCommandlet Interface
+	int32 Main(const FString& Params) override;
+	//~ End UCommandlet Interface
+};
@@ -0,0 +1,790 @@
+
+
+#include "DtsBuild.h"
+#include "DtsFactory.h"
+#include "DtsImposter.h"
+#include "DtsMaterials.h"
+#include "DtsMemory.h"
+#include "DtsShape.h"
+#include "DtsSortedMesh.h"
+#include "DtsTangents.h"
+
+#include "AssetRegistryModule.h"
+#include "Async/ParallelFor.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/StaticMeshSocket.h"
+#include "Materials/MaterialInterface.h"
+#include "MeshDescription.h"
+#include "Misc/PackageName.h"
+#include "ObjectTools.h"
+#include "StaticMeshAttributes.h"
+#include "UObject/Package.h"
+
+
+FTransform GetNodeTransform(const FDtsShape& shape, int32_t nodeIndex)
+{
+	FTransform transform = FTransform::Identity;
+	for (int32_t guard = 0; nodeIndex >= 0 && nodeIndex < int32_t(shape.nodes.size()) && guard < int32_t(shape.nodes.size()); guard++)
+	{
+		const FDtsNode& node = shape.nodes[nodeIndex];
+		transform = transform * FTransform(node.defaultRotation.Inverse(), node.defaultTranslation);
+		nodeIndex = node.parentIndex;
+	}
+	return transform;
+}
+
+
+FVector ToUnrealVector(const FVector& v)
+{
+	return FVector(v.X, -v.Y, v.Z);
+}
+
+
+FTransform ToUnrealTransform(const FTransform& transform, float scale)
+{
+	const FQuat rotation = transform.GetRotation();
+	return FTransform(FQuat(-rotation.X, rotation.Y, -rotation.Z, rotation.W), ToUnrealVector(transform.GetTranslation()) * scale);
+}
+
+
+// Appends the triangles of a primitive list to trianglesByMaterial (key is the DTS material index, -1 for none).
+// primitiveOrder, if given, is the draw order; primitives it doesn't list follow in file order.
+void DtsTriangulate(const FDtsMesh& mesh, TMap<int32, TArray<int32>>& trianglesByMaterial, const TArray<int32>* primitiveOrder)
+{
+	TArray<int32> order;
+	if (primitiveOrder)
+	{
+		TBitArray<> listed(false, mesh.primitives.size());
+		for (int32 primitiveIndex : *primitiveOrder)
+		{
+			if (primitiveIndex >= 0 && primitiveIndex < listed.Num() && !listed[primitiveIndex])
+			{
+				listed[primitiveIndex] = true;
+				order.Add(primitiveIndex);
+			}
+		}
+		for (auto i = 0; i < listed.Num(); i++)
+		{
+			if (!listed[i])
+			{
+				order.Add(i);
+			}
+		}
+	}
+	else
+	{
+		for (auto i = 0; i < int32(mesh.primitives.size()); i++)
+		{
+			order.Add(i);
+		}
+	}
+
+	const int32 numIndices = mesh.indices.size();
+	for (int32 primitiveIndex : order)
+	{
+		const FDtsPrimitive& primitive = mesh.primitives[primitiveIndex];
+		const int32 material = (primitive.matIndex & PrimitiveNoMaterial) ? -1 : int32(primitive.matIndex & PrimitiveMaterialMask);
+		TArray<int32>& triangles = trianglesByMaterial.FindOrAdd(material);
+		if (primitive.start < 0 || primitive.numElements < 3 || primitive.start + primitive.numElements > numIndices)
+		{
+			continue;
+		}
+		const int32_t* indices = mesh.indices.data() + primitive.start;
+		auto addTriangle = [&triangles](int32 a, int32 b, int32 c)
+		{
+			if (a != b && b != c && a != c)
+			{
+				triangles.Add(a);
+				triangles.Add(b);
+				triangles.Add(c);
+			}
+		};
+		switch (primitive.matIndex & PrimitiveTypeMask)
+		{
+		case PrimitiveStrip:
+			for (auto i = 2; i < primitive.numElements; i++)
+			{
+				if (i & 1)
+				{
+					addTriangle(indices[i - 1], indices[i - 2], indices[i]);
+				}
+				else
+				{
+					addTriangle(indices[i - 2], indices[i - 1], indices[i]);
+				}
+			}
+			break;
+		case PrimitiveFan:
+			for (auto i = 2; i < primitive.numElements; i++)
+			{
+				addTriangle(indices[0], indices[i - 1], indices[i]);
+			}
+			break;
+		default:
+			for (auto i = 0; i + 2 < primitive.numElements; i += 3)
+			{
+				addTriangle(indices[i], indices[i + 1], indices[i + 2]);
+			}
+			break;
+		}
+	}
+}
+
+
+// Indices of the objects drawn by a detail level and of their mesh at that level
+void DtsGetDetailMeshes(const FDtsShape& shape, const FDtsDetail& detail, TArray<int32>& objectIndices, TArray<int32>& meshIndices)
+{
+	if (detail.subShapeNum < 0 || detail.subShapeNum >= int32_t(shape.subShapeFirstObject.size()) || detail.objectDetailNum < 0)
+	{
+		return;
+	}
+	const int32_t firstObject = shape.subShapeFirstObject[detail.subShapeNum];
+	const int32_t numObjects = shape.subShapeNumObjects[detail.subShapeNum];
+	for (auto i = firstObject; i < firstObject + numObjects && i < int32_t(shape.objects.size()); i++)
+	{
+		const FDtsObject& object = shape.objects[i];
+		const int32_t meshIndex = object.startMeshIndex + detail.objectDetailNum;
+		if (detail.objectDetailNum >= object.numMeshes || meshIndex >= int32_t(shape.meshes.size()))
+		{
+			continue;
+		}
+		const uint32_t meshType = shape.meshes[meshIndex].meshType;
+		if (meshType == NullMeshType || meshType == DecalMeshType)
+		{
+			continue;
+		}
+		objectIndices.Add(i);
+		meshIndices.Add(meshIndex);
+	}
+}
+
+
+namespace
+{
+
+struct FDtsMeshInstance
+{
+	int32 objectIndex;
+	int32 meshIndex;
+	FTransform transform;		// DTS space
+};
+
+
+// Number of vertices of the first keyframe of a mesh
+int32 GetNumFrameVerts(const FDtsMesh& mesh, const FDtsMesh& vertexData)
+{
+	return FMath::Min<int32>(mesh.vertsPerFrame > 0 ? mesh.vertsPerFrame : vertexData.verts.size(), vertexData.verts.size());
+}
+
+
+// Triangulated geometry, computed once per set of identical meshes (keyed by the first of them).
+// Sorted meshes are triangulated in the order their cluster walk draws them from sortedMeshOctant (mesh space octant bits).
+// With generateTangents, normals (unless trustNormals) and tangents of the first keyframe are computed along with it.
+class FDtsTriangulationCache
+{
+public:
+	FDtsTriangulationCache(int32 inSortedMeshOctant, bool inGenerateTangents, bool inTrustNormals)
+		: sortedMeshOctant(inSortedMeshOctant)
+		, generateTangents(inGenerateTangents)
+		, trustNormals(inTrustNormals)
+	{
+	}
+
+	struct FEntry
+	{
+		TMap<int32, TArray<int32>> trianglesByMaterial;
+		TArray<FVector> normals;				// DTS space, empty unless generateTangents
+		TArray<FVector4> tangents;				// DTS space, bitangent sign in W
+		TArray<FVector4> mirroredTangents;		// The same for corners with mirrored UVs, empty if there are none
+		double seconds = 0.0;
+	};
+
+	bool hasTangents() const
+	{
+		return generateTangents;
+	}
+
+	// Computes the entries of all meshes used by the LODs on worker threads
+	void prepare(const FDtsShape& shape, const TArray<TArray<FDtsMeshInstance>>& lods)
+	{
+		TArray<int32> keys;
+		for (const TArray<FDtsMeshInstance>& instances : lods)
+		{
+			for (const FDtsMeshInstance& instance : instances)
+			{
+				const int32 key = getKey(shape, instance.meshIndex);
+				if (!entries.Contains(key))
+				{
+					entries.Add(key);
+					keys.Add(key);
+				}
+			}
+		}
+		// Entries are stable from here on: nothing is added to the map while the workers run
+		TArray<FEntry*> added;
+		for (int32 key : keys)
+		{
+			added.Add(&entries[key]);
+		}
+		ParallelFor(keys.Num(), [this, &shape, &keys, &added](int32 i)
+		{
+			fill(shape, keys[i], *added[i]);
+		});
+	}
+
+	const FEntry& get(const FDtsShape& shape, int32 meshIndex, FDtsDedupStats& stats)
+	{
+		const int32 key = getKey(shape, meshIndex);
+		if (FStoredEntry* found = entries.Find(key))
+		{
+			if (found->counted)
+			{
+				stats.buildSecondsSaved += found->seconds;
+			}
+			found->counted = true;
+			return *found;
+		}
+		FStoredEntry& entry = entries.Add(key);
+		fill(shape, key, entry);
+		entry.counted = true;
+		return entry;
+	}
+
+	int64 getAllocatedSize() const
+	{
+		int64 bytes = entries.GetAllocatedSize();
+		for (const auto& pair : entries)
+		{
+			bytes += pair.Value.trianglesByMaterial.GetAllocatedSize() + pair.Value.normals.GetAllocatedSize() + pair.Value.tangents.GetAllocatedSize()
+				+ pair.Value.mirroredTangents.GetAllocatedSize();
+			for (const auto& triangles : pair.Value.trianglesByMaterial)
+			{
+				bytes += triangles.Value.GetAllocatedSize();
+			}
+		}
+		return bytes;
+	}
+
+private:
+	struct FStoredEntry : FEntry
+	{
+		bool counted = false;					// Returned by get() at least once, later gets are reuses
+	};
+
+	static int32 getKey(const FDtsShape& shape, int32 meshIndex)
+	{
+		return shape.meshes[meshIndex].instanceOf >= 0 ? shape.meshes[meshIndex].instanceOf : meshIndex;
+	}
+
+	void fill(const FDtsShape& shape, int32 key, FEntry& entry) const
+	{
+		const double startTime = FPlatformTime::Seconds();
+		const FDtsMesh& mesh = shape.meshes[key];
+		if (mesh.meshType == SortedMeshType && !mesh.clusters.empty())
+		{
+			FDtsClusterTree tree(mesh);
+			TArray<int32> primitiveOrder;
+			tree.getOctantOrder(mesh.center, mesh.radius, sortedMeshOctant, primitiveOrder);
+			DtsTriangulate(mesh, entry.trianglesByMaterial, &primitiveOrder);
+		}
+		else
+		{
+			DtsTriangulate(mesh, entry.trianglesByMaterial);
+		}
+		if (generateTangents)
+		{
+			const FDtsMesh& vertexData = shape.getVertexData(key);
+			const int32 numVerts = GetNumFrameVerts(mesh, vertexData);
+			TArray<const TArray<int32>*> triangles;
+			for (const auto& pair : entry.trianglesByMaterial)
+			{
+				triangles.Add(&pair.Value);
+			}
+			if (trustNormals && int32(vertexData.norms.size()) >= numVerts)
+			{
+				entry.normals.Append(vertexData.norms.data(), numVerts);
+			}
+			const FVector2D* uvs = int32(vertexData.tverts.size()) >= numVerts ? vertexData.tverts.data() : nullptr;
+			DtsComputeTangents(vertexData.verts.data(), uvs, numVerts, triangles, entry.normals, entry.tangents, entry.mirroredTangents);
+		}
+		entry.seconds = FPlatformTime::Seconds() - startTime;
+	}
+
+	int32 sortedMeshOctant;
+	bool generateTangents;
+	bool trustNormals;
+	TMap<int32, FStoredEntry> entries;
+};
+
+
+int32 GetGeometryKey(const FDtsShape& shape, int32 meshIndex)
+{
+	return shape.meshes[meshIndex].instanceOf >= 0 ? shape.meshes[meshIndex].instanceOf : meshIndex;
+}
+
+}
+
+
+static void AppendMesh(const FDtsShape& shape, const FDtsMeshInstance& instance, float scale, const TMap<int32, int32>& slotForMaterial, const TArray<FName>& slotNames,
+	FDtsTriangulationCache& cache, FDtsDedupStats& stats, FMeshDescription& meshDescription, TMap<int32, FPolygonGroupID>& groupForSlot)
+{
+	FStaticMeshAttributes attributes(meshDescription);
+	TVertexAttributesRef<FVector> positions = attributes.GetVertexPositions();
+	TVertexInstanceAttributesRef<FVector> normals = attributes.GetVertexInstanceNormals();
+	TVertexInstanceAttributesRef<FVector> tangents = attributes.GetVertexInstanceTangents();
+	TVertexInstanceAttributesRef<float> binormalSigns = attributes.GetVertexInstanceBinormalSigns();
+	TVertexInstanceAttributesRef<FVector2D> uvs = attributes.GetVertexInstanceUVs();
+	TPolygonGroupAttributesRef<FName> slotNamesAttribute = attributes.GetPolygonGroupMaterialSlotNames();
+
+	// Only the first position and UV keyframes are imported. DTS verts are already split per normal/UV, so a vertex has one
+	// instance, plus a second one on mirror seams where generated tangents differ in handedness
+	const FDtsMesh& mesh = shape.meshes[instance.meshIndex];
+	const FDtsMesh& vertexData = shape.getVertexData(instance.meshIndex);
+	const FTransform& transform = instance.transform;
+	const int32 numVerts = GetNumFrameVerts(mesh, vertexData);
+	const FDtsTriangulationCache::FEntry& geometry = cache.get(shape, instance.meshIndex, stats);
+	const bool hasTangents = geometry.normals.Num() >= numVerts && geometry.tangents.Num() >= numVerts;
+	const bool hasMirroredTangents = hasTangents && geometry.mirroredTangents.Num() >= numVerts && int32(vertexData.tverts.size()) >= numVerts;
+	TArray<FVertexID> vertices;
+	vertices.SetNum(numVerts);
+	for (auto i = 0; i < numVerts; i++)
+	{
+		vertices[i] = meshDescription.CreateVertex();
+		positions[vertices[i]] = ToUnrealVector(transform.TransformPosition(vertexData.verts[i])) * scale;
+	}
+	TArray<FVertexInstanceID> instances;
+	instances.Init(FVertexInstanceID::Invalid, numVerts * 2);
+	auto getInstance = [&](int32 i, bool mirrored)
+	{
+		FVertexInstanceID& instanceID = instances[i * 2 + (mirrored ? 1 : 0)];
+		if (instanceID != FVertexInstanceID::Invalid)
+		{
+			return instanceID;
+		}
+		instanceID = meshDescription.CreateVertexInstance(vertices[i]);
+		if (hasTangents)
+		{
+			// Mirroring flips the bitangent relative to cross(normal, tangent)
+			const FVector4& tangent = mirrored ? geometry.mirroredTangents[i] : geometry.tangents[i];
+			normals[instanceID] = ToUnrealVector(transform.TransformVectorNoScale(geometry.normals[i])).GetSafeNormal();
+			tangents[instanceID] = ToUnrealVector(transform.TransformVectorNoScale(FVector(tangent))).GetSafeNormal();
+			binormalSigns[instanceID] = -tangent.W;
+		}
+		else if (i < int32(vertexData.norms.size()))
+		{
+			normals[instanceID] = ToUnrealVector(transform.TransformVectorNoScale(vertexData.norms[i])).GetSafeNormal();
+		}
+		if (i < int32(vertexData.tverts.size()))
+		{
+			uvs.Set(instanceID, 0, vertexData.tverts[i]);
+		}
+		return instanceID;
+	};
+
+	for (const auto& pair : geometry.trianglesByMaterial)
+	{
+		const int32* slot = slotForMaterial.Find(pair.Key);
+		if (!slot || pair.Value.Num() == 0)
+		{
+			continue;
+		}
+		FPolygonGroupID* group = groupForSlot.Find(*slot);
+		if (!group)
+		{
+			group = &groupForSlot.Add(*slot, meshDescription.CreatePolygonGroup());
+			slotNamesAttribute[*group] = slotNames[*slot];
+		}
+		const TArray<int32>& triangles = pair.Value;
+		for (auto i = 0; i + 2 < triangles.Num(); i += 3)
+		{
+			if (triangles[i] < 0 || triangles[i + 1] < 0 || triangles[i + 2] < 0 || triangles[i] >= numVerts || triangles[i + 1] >= numVerts || triangles[i + 2] >= numVerts)
+			{
+				continue;
+			}
+			const bool mirrored = hasMirroredTangents
+				&& DtsIsMirroredUV(vertexData.tverts[triangles[i]], vertexData.tverts[triangles[i + 1]], vertexData.tverts[triangles[i + 2]]);
+			// Mirroring Y flips handedness, so reverse the winding
+			TArray<FVertexInstanceID> polygon;
+			polygon.Add(getInstance(triangles[i], mirrored));
+			polygon.Add(getInstance(triangles[i + 2], mirrored));
+			polygon.Add(getInstance(triangles[i + 1], mirrored));
+			meshDescription.CreatePolygon(*group, polygon);
+		}
+	}
+}
+
+
+// One quad per equator view (and pole view) through the imposter center, facing that view and showing its tile.
+// Backface culling leaves the quad facing the camera most; opposite views share a plane.
+static void AppendImposter(const FDtsImposterAtlas& atlas, float scale, FPolygonGroupID group, FMeshDescription& meshDescription)
+{
+	FStaticMeshAttributes attributes(meshDescription);
+	TVertexAttributesRef<FVector> positions = attributes.GetVertexPositions();
+	TVertexInstanceAttributesRef<FVector> normals = attributes.GetVertexInstanceNormals();
+	TVertexInstanceAttributesRef<FVector> tangents = attributes.GetVertexInstanceTangents();
+	TVertexInstanceAttributesRef<float> binormalSigns = attributes.GetVertexInstanceBinormalSigns();
+	TVertexInstanceAttributesRef<FVector2D> uvs = attributes.GetVertexInstanceUVs();
+
+	TArray<int32> views;
+	for (auto i = 0; i < atlas.numEquatorViews; i++)
+	{
+		views.Add(atlas.firstEquatorView + i);
+	}
+	if (atlas.firstPoleView >= 0)
+	{
+		views.Add(atlas.firstPoleView);
+		views.Add(atlas.firstPoleView + 1);
+	}
+	for (int32 view : views)
+	{
+		// Same basis as the rasterizer: tile x along right, tile y down along screenUp
+		const FVector direction = atlas.viewDirections[view];
+		const FVector up = FMath::Abs(direction.Z) > 0.999f ? FVector(1.0f, 0.0f, 0.0f) : FVector(0.0f, 0.0f, 1.0f);
+		const FVector right = FVector::CrossProduct(-direction, up).GetSafeNormal();
+		const FVector screenUp = FVector::CrossProduct(right, -direction);
+		FVector2D uvMin;
+		FVector2D uvMax;
+		atlas.getTileUVs(view, uvMin, uvMax);
+
+		const FVector normal = ToUnrealVector(direction);
+		const FVector tangent = ToUnrealVector(right);
+		const float binormalSign = FVector::DotProduct(FVector::CrossProduct(normal, tangent), ToUnrealVector(-screenUp)) < 0.0f ? -1.0f : 1.0f;
+		const FVector2D corners[4] = { FVector2D(-1.0f, 1.0f), FVector2D(1.0f, 1.0f), FVector2D(1.0f, -1.0f), FVector2D(-1.0f, -1.0f) };
+		FVertexInstanceID instances[4];
+		FVector cornerPositions[4];
+		for (auto i = 0; i < 4; i++)
+		{
+			const FVector position = atlas.center + (right * corners[i].X + screenUp * corners[i].Y) * atlas.radius;
+			const FVertexID vertexID = meshDescription.CreateVertex();
+			cornerPositions[i] = ToUnrealVector(position) * scale;
+			positions[vertexID] = cornerPositions[i];
+			instances[i] = meshDescription.CreateVertexInstance(vertexID);
+			normals[instances[i]] = normal;
+			tangents[instances[i]] = tangent;
+			binormalSigns[instances[i]] = binormalSign;
+			uvs.Set(instances[i], 0, FVector2D(corners[i].X < 0.0f ? uvMin.X : uvMax.X, corners[i].Y > 0.0f ? uvMin.Y : uvMax.Y));
+		}
+		// Unreal's face normal of (a, b, c) is (c - a) x (b - a); wind the quad so it faces the view
+		const bool flip = FVector::DotProduct(FVector::CrossProduct(cornerPositions[2] - cornerPositions[0], cornerPositions[1] - cornerPositions[0]), normal) < 0.0f;
+		const int32 order[2][3] = { { 0, 1, 2 }, { 0, 2, 3 } };
+		for (const auto& triangle : order)
+		{
+			TArray<FVertexInstanceID> polygon;
+			polygon.Add(instances[triangle[0]]);
+			polygon.Add(instances[flip ? triangle[2] : triangle[1]]);
+			polygon.Add(instances[flip ? triangle[1] : triangle[2]]);
+			meshDescription.CreatePolygon(group, polygon);
+		}
+	}
+}
+
+
+// Detail level sizes are the projected radius in pixels at which Torque switches to the level; this is the screen height they are measured against
+static const float DetailReferenceScreenHeight = 1080.0f;
+
+
+// Maps detail level pixel sizes to LOD screen sizes (projected diameter over screen height), kept strictly decreasing as the engine requires
+static void SetLODScreenSizes(UStaticMesh* staticMesh, const TArray<float>& detailSizes)
+{
+	staticMesh->bAutoComputeLODScreenSize = false;
+	float previous = 1.0f;
+	for (auto lod = 0; lod < staticMesh->GetNumSourceModels() && lod < detailSizes.Num(); lod++)
+	{
+		float screenSize = FMath::Clamp(2.0f * detailSizes[lod] / DetailReferenceScreenHeight, 0.0f, 1.0f);
+		if (lod > 0)
+		{
+			screenSize = FMath::Min(screenSize, previous * 0.99f);
+		}
+		staticMesh->GetSourceModel(lod).ScreenSize.Default = screenSize;
+		previous = screenSize;
+	}
+}
+
+
+// detailSizes holds the pixel size of each LOD's detail level, followed by the billboard's when imposter is given.
+// imposter, if given, adds a last LOD drawn with imposterMaterial
+static UStaticMesh* CreateStaticMesh(const FDtsShape& shape, const TArray<TArray<FDtsMeshInstance>>& lods, const TArray<float>& detailSizes,
+	const TArray<UMaterialInterface*>& materials, float scale, UObject* outer, FName name, EObjectFlags flags, FDtsTriangulationCache& cache, FDtsDedupStats& stats,
+	const FDtsImposterAtlas* imposter = nullptr, UMaterialInterface* imposterMaterial = nullptr)
+{
+	UStaticMesh* staticMesh = NewObject<UStaticMesh>(outer, name, flags | RF_Public | RF_Standalone);
+
+	// One material slot per DTS material used by any LOD
+	TMap<int32, int32> slotForMaterial;
+	TArray<FName> slotNames;
+	for (const TArray<FDtsMeshInstance>& instances : lods)
+	{
+		for (const FDtsMeshInstance& instance : instances)
+		{
+			for (const FDtsPrimitive& primitive : shape.meshes[instance.meshIndex].primitives)
+			{
+				const int32 material = (primitive.matIndex & PrimitiveNoMaterial) ? -1 : int32(primitive.matIndex & PrimitiveMaterialMask);
+				if (slotForMaterial.Contains(material))
+				{
+					continue;
+				}
+				FName slotName = material >= 0 && material < int32(shape.materials.size()) ? FName(UTF8_TO_TCHAR(shape.materials[material].name.c_str())) : FName(TEXT("None"));
+				slotForMaterial.Add(material, slotNames.Num());
+				slotNames.Add(slotName);
+				UMaterialInterface* slotMaterial = material >= 0 && material < materials.Num() ? materials[material] : nullptr;
+				staticMesh->StaticMaterials.Add(FStaticMaterial(slotMaterial, slotName, slotName));
+			}
+		}
+	}
+
+	for (auto lod = 0; lod < lods.Num(); lod++)
+	{
+		FStaticMeshSourceModel& sourceModel = staticMesh->AddSourceModel();
+		sourceModel.BuildSettings.bRecomputeNormals = false;
+		sourceModel.BuildSettings.bRecomputeTangents = !cache.hasTangents();
+		sourceModel.BuildSettings.bUseFullPrecisionUVs = false;
+		sourceModel.BuildSettings.bUseHighPrecisionTangentBasis = false;
+		for (const FDtsMeshInstance& instance : lods[lod])
+		{
+			const FDtsMesh& vertexData = shape.getVertexData(instance.meshIndex);
+			sourceModel.BuildSettings.bUseFullPrecisionUVs |= vertexData.fullPrecisionUVs;
+			sourceModel.BuildSettings.bUseHighPrecisionTangentBasis |= vertexData.highPrecisionNormals;
+		}
+		FMeshDescription* meshDescription = staticMesh->CreateMeshDescription(lod);
+		FStaticMeshAttributes(*meshDescription).Register();
+
+		TMap<int32, FPolygonGroupID> groupForSlot;
+		for (const FDtsMeshInstance& instance : lods[lod])
+		{
+			AppendMesh(shape, instance, scale, slotForMaterial, slotNames, cache, stats, *meshDescription, groupForSlot);
+		}
+
+		// Sections follow polygon group creation order
+		int32 section = 0;
+		for (const auto& pair : groupForSlot)
+		{
+			staticMesh->GetSectionInfoMap().Set(lod, section++, FMeshSectionInfo(pair.Key));
+		}
+		staticMesh->CommitMeshDescription(lod);
+	}
+
+	if (imposter)
+	{
+		const int32 lod = lods.Num();
+		const int32 slot = staticMesh->StaticMaterials.Add(FStaticMaterial(imposterMaterial, TEXT("Imposter"), TEXT("Imposter")));
+		FStaticMeshSourceModel& sourceModel = staticMesh->AddSourceModel();
+		sourceModel.BuildSettings.bRecomputeNormals = false;
+		sourceModel.BuildSettings.bRecomputeTangents = false;
+		FMeshDescription* meshDescription = staticMesh->CreateMeshDescription(lod);
+		FStaticMeshAttributes(*meshDescription).Register();
+		const FPolygonGroupID group = meshDescription->CreatePolygonGroup();
+		FStaticMeshAttributes(*meshDescription).GetPolygonGroupMaterialSlotNames()[group] = TEXT("Imposter");
+		AppendImposter(*imposter, scale, group, *meshDescription);
+		staticMesh->GetSectionInfoMap().Set(lod, 0, FMeshSectionInfo(slot));
+		staticMesh->CommitMeshDescription(lod);
+	}
+
+	SetLODScreenSizes(staticMesh, detailSizes);
+	staticMesh->Build(false);
+	staticMesh->PostEditChange();
+	return staticMesh;
+}
+
+
+UStaticMesh* UDtsFactory::buildStaticMesh(const FDtsShape& shape, const TArray<UMaterialInterface*>& materials, UObject* InParent, FName Name, EObjectFlags Flags, FDtsDedupStats& stats)
+{
+	TArray<FTransform> objectTransforms;
+	for (const FDtsObject& object : shape.objects)
+	{
+		objectTransforms.Add(GetNodeTransform(shape, object.nodeIndex));
+	}
+
+	// Visible detail levels become LODs; negative sizes are collision and other never-drawn levels.
+	// A level whose objects use exactly the same geometry as the previous one adds nothing and is dropped.
+	TArray<TArray<FDtsMeshInstance>> lods;
+	TArray<float> detailSizes;
+	TArray<TPair<int32, int32>> previousSignature;
+	for (const FDtsDetail& detail : shape.details)
+	{
+		if (detail.size < 0.0f)
+		{
+			continue;
+		}
+		TArray<int32> objectIndices;
+		TArray<int32> meshIndices;
+		DtsGetDetailMeshes(shape, detail, objectIndices, meshIndices);
+		if (meshIndices.Num() == 0)
+		{
+			continue;
+		}
+		TArray<TPair<int32, int32>> signature;
+		TArray<FDtsMeshInstance> instances;
+		for (auto i = 0; i < meshIndices.Num(); i++)
+		{
+			signature.Add(TPair<int32, int32>(objectIndices[i], GetGeometryKey(shape, meshIndices[i])));
+			instances.Add(FDtsMeshInstance{ objectIndices[i], meshIndices[i], objectTransforms[objectIndices[i]] });
+		}
+		if (signature == previousSignature)
+		{
+			stats.numReusedLods++;
+			continue;
+		}
+		previousSignature = MoveTemp(signature);
+		lods.Add(MoveTemp(instances));
+		detailSizes.Add(detail.size);
+	}
+	if (lods.Num() == 0)
+	{
+		UE_LOG(LogDts, Error, TEXT("Shape has no visible detail levels"));
+		return nullptr;
+	}
+
+	// The smallest billboard detail level (v26+, no subshape) is rendered into an atlas shown by the last LOD
+	const FString destinationPath = FPackageName::GetLongPackagePath(InParent->GetOutermost()->GetName());
+	const FDtsDetail* billboard = nullptr;
+	for (const FDtsDetail& detail : shape.details)
+	{
+		if (shape.version >= 26 && detail.subShapeNum < 0 && detail.size >= 0.0f && detail.bbDetailLevel >= 0 && detail.bbDetailLevel < int32(shape.details.size()))
+		{
+			billboard = &detail;
+		}
+	}
+	FDtsImposterAtlas imposter;
+	UMaterialInterface* imposterMaterial = nullptr;
+	TUniquePtr<FDtsMemoryScope> imposterScope;
+	if (billboard && bGenerateImposters)
+	{
+		TArray<FDtsImposterTexture> textures;
+		DtsReadImposterTextures(shape, materials, textures);
+		const double startTime = FPlatformTime::Seconds();
+		if (DtsRenderImposters(shape, *billboard, textures, ImposterTileSize, imposter))
+		{
+			imposterScope = MakeUnique<FDtsMemoryScope>(*memory, EDtsMemoryStage::Build, imposter.pixels.GetAllocatedSize());
+			const double elapsed = FPlatformTime::Seconds() - startTime;
+			UE_LOG(LogDts, Log, TEXT("Rendered %d imposter views of %dx%d pixels [%s] in %.3f ms (%.3f ms per view)"), imposter.viewDirections.Num(),
+				imposter.tileSize, imposter.tileSize, *Name.ToString(), elapsed * 1000.0, elapsed * 1000.0 / imposter.viewDirections.Num());
+			UMaterialInterface* parentMaterial = Cast<UMaterialInterface>(ImposterMaterial.TryLoad());
+			if (parentMaterial && !DtsHasTextureParameter(parentMaterial, FDtsMaterialImporter::DiffuseTextureParam))
+			{
+				UE_LOG(LogDts, Warning, TEXT("Imposter material [%s] has no %s parameter, using a generated parent instead"),
+					*parentMaterial->GetPathName(), *FDtsMaterialImporter::DiffuseTextureParam.ToString());
+				parentMaterial = nullptr;
+			}
+			if (!parentMaterial)
+			{
+				parentMaterial = DtsCreateBaseMaterial(destinationPath, TEXT("M_DtsImposter"), true);
+			}
+			imposterMaterial = DtsCreateImposterMaterial(imposter, parentMaterial, destinationPath, ObjectTools::SanitizeObjectName(Name.ToString() + TEXT("_Imposter")));
+		}
+		else
+		{
+			UE_LOG(LogDts, Warning, TEXT("Billboard detail of [%s] draws nothing, no imposter created"), *Name.ToString());
+		}
+	}
+
+	// Unreal's Y is mirrored relative to DTS
+	FDtsTriangulationCache cache((SortedMeshViewOctant & 7) ^ 2, bGenerateTangents, bTrustFileNormals);
+	const double prepareStartTime = FPlatformTime::Seconds();
+	cache.prepare(shape, lods);
+	FDtsMemoryScope cacheScope(*memory, EDtsMemoryStage::Build, cache.getAllocatedSize());
+	UE_LOG(LogDts, Log, TEXT("Triangulated%s [%s] in %.3f ms"), bGenerateTangents ? TEXT(" and generated tangents") : TEXT(""),
+		*Name.ToString(), (FPlatformTime::Seconds() - prepareStartTime) * 1000.0);
+
+	// Objects sharing their top LOD geometry are built once as a separate mesh. The imported mesh only records where they go, as tagged sockets;
+	// nothing spawns them, that is left to whoever places the mesh
+	struct FInstancedGroup
+	{
+		TArray<int32> objects;
+		UStaticMesh* staticMesh = nullptr;
+	};
+	TMap<int32, FInstancedGroup> groups;		// geometry key -> objects using it
+	if (bInstanceDuplicateMeshes)
+	{
+		for (const FDtsMeshInstance& instance : lods[0])
+		{
+			groups.FindOrAdd(GetGeometryKey(shape, instance.meshIndex)).objects.Add(instance.objectIndex);
+		}
+		for (auto it = groups.CreateIterator(); it; ++it)
+		{
+			if (it->Value.objects.Num() < 2)
+			{
+				it.RemoveCurrent();
+			}
+		}
+		// Keep something in the main mesh
+		bool allInstanced = true;
+		for (const FDtsMeshInstance& instance : lods[0])
+		{
+			allInstanced &= groups.Contains(GetGeometryKey(shape, instance.meshIndex));
+		}
+		if (allInstanced)
+		{
+			groups.Remove(GetGeometryKey(shape, lods[0][0].meshIndex));
+		}
+	}
+
+	TSet<int32> instancedObjects;
+	for (auto& pair : groups)
+	{
+		FInstancedGroup& group = pair.Value;
+		const int32 firstObject = group.objects[0];
+		TArray<TArray<FDtsMeshInstance>> groupLods;
+		TArray<float> groupDetailSizes;
+		for (auto lod = 0; lod < lods.Num(); lod++)
+		{
+			for (const FDtsMeshInstance& instance : lods[lod])
+			{
+				if (instance.objectIndex == firstObject)
+				{
+					groupLods.Add({ FDtsMeshInstance{ instance.objectIndex, instance.meshIndex, FTransform::Identity } });
+					groupDetailSizes.Add(detailSizes[lod]);
+				}
+			}
+		}
+		const FString objectName = UTF8_TO_TCHAR(shape.getName(shape.objects[firstObject].nameIndex).c_str());
+		const FString assetName = ObjectTools::SanitizeObjectName(Name.ToString() + TEXT("_") + objectName);
+		UPackage* package = CreatePackage(nullptr, *(destinationPath / assetName));
+		const double startTime = FPlatformTime::Seconds();
+		group.staticMesh = CreateStaticMesh(shape, groupLods, groupDetailSizes, materials, ImportScale, package, FName(*assetName), Flags, cache, stats);
+		memory->add(EDtsMemoryStage::Build, group.staticMesh->GetResourceSizeBytes(EResourceSizeMode::EstimatedTotal));
+		stats.buildSecondsSaved += (FPlatformTime::Seconds() - startTime) * (group.objects.Num() - 1);
+		FAssetRegistryModule::AssetCreated(group.staticMesh);
+		package->MarkPackageDirty();
+		for (int32 object : group.objects)
+		{
+			instancedObjects.Add(object);
+		}
+	}
+
+	for (auto lod = lods.Num() - 1; lod >= 0; lod--)
+	{
+		lods[lod].RemoveAll([&instancedObjects](const FDtsMeshInstance& instance) { return instancedObjects.Contains(instance.objectIndex); });
+		if (lods[lod].Num() == 0)
+		{
+			lods.RemoveAt(lod);
+			detailSizes.RemoveAt(lod);
+		}
+	}
+	if (imposterMaterial)
+	{
+		detailSizes.Add(billboard->size);
+	}
+
+	UStaticMesh* staticMesh = CreateStaticMesh(shape, lods, detailSizes, materials, ImportScale, InParent, Name, Flags, cache, stats,
+		imposterMaterial ? &imposter : nullptr, imposterMaterial);
+	memory->add(EDtsMemoryStage::Build, staticMesh->GetResourceSizeBytes(EResourceSizeMode::EstimatedTotal));
+	for (const auto& pair : groups)
+	{
+		for (int32 object : pair.Value.objects)
+		{
+			UStaticMeshSocket* socket = NewObject<UStaticMeshSocket>(staticMesh);
+			const FTransform transform = ToUnrealTransform(objectTransforms[object], ImportScale);
+			socket->SocketName = FName(UTF8_TO_TCHAR(shape.getName(shape.objects[object].nameIndex).c_str()));
+			socket->RelativeLocation = transform.GetLocation();
+			socket->RelativeRotation = transform.Rotator();
+			socket->Tag = pair.Value.staticMesh->GetPathName();
+			staticMesh->Sockets.Add(socket);
+		}
+	}
+	if (instancedObjects.Num() > 0)
+	{
+		UE_LOG(LogDts, Log, TEXT("%d objects of [%s] moved to %d separate meshes; they are only referenced by sockets and must be placed by the user"),
+			instancedObjects.Num(), *Name.ToString(), groups.Num());
+	}
+	return staticMesh;
+}
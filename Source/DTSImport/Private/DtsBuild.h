@@ -0,0 +1,21 @@
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FDtsShape;
+struct FDtsMesh;
+struct FDtsDetail;
+
+
+// Torque is right handed and stores rotations inverted (its matrices are transposed), Unreal is left handed.
+// Conversion mirrors Y, which also reverses triangle winding.
+
+// Default pose transform of a node in shape space (DTS space)
+FTransform GetNodeTransform(const FDtsShape& shape, int32_t nodeIndex);
+FVector ToUnrealVector(const FVector& v);
+FTransform ToUnrealTransform(const FTransform& transform, float scale);
+
+void DtsTriangulate(const FDtsMesh& mesh, TMap<int32, TArray<int32>>& trianglesByMaterial, const TArray<int32>* primitiveOrder = nullptr);
+void DtsGetDetailMeshes(const FDtsShape& shape, const FDtsDetail& detail, TArray<int32>& objectIndices, TArray<int32>& meshIndices);
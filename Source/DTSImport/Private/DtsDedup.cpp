@@ -0,0 +1,159 @@
+
+
+#include "DtsDedup.h"
+#include "DtsShape.h"
+
+#include "Hash/CityHash.h"
+
+
+template<typename T>
+static uint64 HashVector(const std::vector<T>& data, uint64 seed)
+{
+	return data.empty() ? seed : CityHash64WithSeed(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(T), seed);
+}
+
+
+template<typename T>
+static bool EqualVector(const std::vector<T>& a, const std::vector<T>& b)
+{
+	return a.size() == b.size() && (a.empty() || FMemory::Memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+}
+
+
+template<typename T>
+static int64 VectorBytes(const std::vector<T>& data)
+{
+	return int64(data.size()) * sizeof(T);
+}
+
+
+static uint64 HashSkin(const FDtsSkin& skin, uint64 hash)
+{
+	hash = HashVector(skin.initialVerts, hash);
+	hash = HashVector(skin.initialNorms, hash);
+	hash = HashVector(skin.initialEncodedNorms, hash);
+	hash = HashVector(skin.initialTransforms, hash);
+	hash = HashVector(skin.vertIndices, hash);
+	hash = HashVector(skin.boneIndices, hash);
+	hash = HashVector(skin.weights, hash);
+	return HashVector(skin.nodeIndices, hash);
+}
+
+
+static bool EqualSkin(const FDtsSkin& a, const FDtsSkin& b)
+{
+	return EqualVector(a.initialVerts, b.initialVerts) && EqualVector(a.initialNorms, b.initialNorms) && EqualVector(a.initialEncodedNorms, b.initialEncodedNorms)
+		&& EqualVector(a.initialTransforms, b.initialTransforms) && EqualVector(a.vertIndices, b.vertIndices) && EqualVector(a.boneIndices, b.boneIndices)
+		&& EqualVector(a.weights, b.weights) && EqualVector(a.nodeIndices, b.nodeIndices);
+}
+
+
+// Everything a mesh stores per vertex must match, including the second UV set, colors and skin, or sharing would change what the shape writes back
+static uint64 HashVertexData(const FDtsMesh& mesh)
+{
+	uint64 hash = HashVector(mesh.verts, uint64(mesh.vertsPerFrame));
+	hash = HashVector(mesh.tverts, hash);
+	hash = HashVector(mesh.tverts2, hash);
+	hash = HashVector(mesh.colors, hash);
+	hash = HashVector(mesh.norms, hash);
+	hash = HashVector(mesh.encodedNorms, hash);
+	return HashSkin(mesh.skin, hash);
+}
+
+
+static bool EqualVertexData(const FDtsMesh& a, const FDtsMesh& b)
+{
+	return a.vertsPerFrame == b.vertsPerFrame && EqualVector(a.verts, b.verts) && EqualVector(a.tverts, b.tverts) && EqualVector(a.tverts2, b.tverts2)
+		&& EqualVector(a.colors, b.colors) && EqualVector(a.norms, b.norms) && EqualVector(a.encodedNorms, b.encodedNorms) && EqualSkin(a.skin, b.skin);
+}
+
+
+// Bytes released when a mesh shares them; skin data stays with each mesh
+static int64 VertexDataBytes(const FDtsMesh& mesh)
+{
+	return VectorBytes(mesh.verts) + VectorBytes(mesh.tverts) + VectorBytes(mesh.tverts2) + VectorBytes(mesh.colors) + VectorBytes(mesh.norms) + VectorBytes(mesh.encodedNorms);
+}
+
+
+static bool EqualPrimitives(const std::vector<FDtsPrimitive>& a, const std::vector<FDtsPrimitive>& b)
+{
+	if (a.size() != b.size())
+	{
+		return false;
+	}
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		if (a[i].start != b[i].start || a[i].numElements != b[i].numElements || a[i].matIndex != b[i].matIndex)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+void FDtsMeshDeduplicator::add(FDtsShape& shape, int32 meshIndex)
+{
+	FDtsMesh& mesh = shape.meshes[meshIndex];
+	if (mesh.meshType == NullMeshType || mesh.meshType == DecalMeshType)
+	{
+		return;
+	}
+
+	if (mesh.parentMesh >= 0 && mesh.parentMesh < meshIndex)
+	{
+		const FDtsMesh& parent = shape.meshes[mesh.parentMesh];
+		mesh.vertexSource = parent.vertexSource >= 0 ? parent.vertexSource : mesh.parentMesh;
+		shape.dedup.numParentShared++;
+		shape.dedup.bytesSaved += VertexDataBytes(shape.meshes[mesh.vertexSource]);
+	}
+	else if (!mesh.verts.empty())
+	{
+		const uint64 hash = HashVertexData(mesh);
+		TArray<int32> candidates;
+		vertexHashes.MultiFind(hash, candidates);
+		for (int32 candidate : candidates)
+		{
+			if (EqualVertexData(shape.meshes[candidate], mesh))
+			{
+				shape.dedup.numContentShared++;
+				shape.dedup.bytesSaved += VertexDataBytes(mesh);
+				mesh.vertexSource = candidate;
+				std::vector<FVector>().swap(mesh.verts);
+				std::vector<FVector2D>().swap(mesh.tverts);
+				std::vector<FVector2D>().swap(mesh.tverts2);
+				std::vector<uint32_t>().swap(mesh.colors);
+				std::vector<FVector>().swap(mesh.norms);
+				std::vector<uint8_t>().swap(mesh.encodedNorms);
+				break;
+			}
+		}
+		if (mesh.vertexSource < 0)
+		{
+			vertexHashes.Add(hash, meshIndex);
+		}
+	}
+
+	// Vertex data is already deduplicated, so identical geometry means the same vertex source and the same primitives/indices
+	const int32 vertexSource = mesh.vertexSource >= 0 ? mesh.vertexSource : meshIndex;
+	uint64 hash = HashVector(mesh.indices, uint64(vertexSource));
+	hash = HashVector(mesh.primitives, hash);
+	TArray<int32> candidates;
+	geometryHashes.MultiFind(hash, candidates);
+	for (int32 candidate : candidates)
+	{
+		const FDtsMesh& other = shape.meshes[candidate];
+		const int32 otherSource = other.vertexSource >= 0 ? other.vertexSource : candidate;
+		if (otherSource == vertexSource && other.meshType == mesh.meshType && EqualVector(other.indices, mesh.indices) && EqualPrimitives(other.primitives, mesh.primitives)
+			&& EqualVector(other.clusters, mesh.clusters) && other.startClusters == mesh.startClusters)
+		{
+			mesh.instanceOf = candidate;
+			shape.dedup.numInstances++;
+			break;
+		}
+	}
+	if (mesh.instanceOf < 0)
+	{
+		geometryHashes.Add(hash, meshIndex);
+	}
+}
@@ -0,0 +1,21 @@
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FDtsShape;
+
+
+// Detects meshes sharing vertex data or whole geometry while the shape is being parsed.
+// Duplicated vertex arrays are released right after the mesh is decoded, so they never accumulate.
+class FDtsMeshDeduplicator
+{
+public:
+	// Call after shape.meshes[meshIndex] has been parsed (meshes must be added in order)
+	void add(FDtsShape& shape, int32 meshIndex);
+
+private:
+	TMultiMap<uint64, int32> vertexHashes;		// hash of all per-vertex data -> mesh holding it
+	TMultiMap<uint64, int32> geometryHashes;	// hash of vertex source + primitives/indices -> first mesh with that geometry
+};
@@ -1,8 +1,17 @@
 
 
 #include "DtsFactory.h"
+#include "DtsShape.h"
+#include "DtsMaterials.h"
+#include "DtsMemory.h"
+#include "DtsQuantize.h"
+
+#include "Async/ParallelFor.h"
+#include "Misc/FileHelper.h"
 
 #include "Misc/Paths.h"
+#include "Misc/PackageName.h"
+#include "Materials/MaterialInterface.h"
 #include "Engine/SkeletalMesh.h"
 #include "Animation/AnimSequence.h"
 #include "Editor/EditorEngine.h"
@@ -30,10 +39,29 @@ UDtsFactory::UDtsFactory(const FObjectInitializer& ObjectInitializer)
 {
 	SupportedClass = nullptr;
 	Formats.Add(TEXT("dts;DTS meshes and animations"));
+	Formats.Add(TEXT("dsq;DSQ sequences"));
 
 	bCreateNew = false;
 	bText = false;
 	bEditorImport = true;
+
+	StreamingThresholdMB = 64;
+	StreamingWindowKB = 1024;
+	ImportScale = 100.0f;
+	bInstanceDuplicateMeshes = false;
+	SortedMeshViewOctant = 5;
+	bGenerateTangents = true;
+	bTrustFileNormals = true;
+	bCheckVertexPrecision = true;
+	UVErrorBudget = 1.0f / 1024.0f;
+	NormalErrorBudgetDegrees = 2.0f;
+	bGenerateImposters = false;
+	ImposterTileSize = 0;
+	AnimSampleRate = 30.0f;
+	bDecodeSequenceFolder = true;
+	SequenceDecodeBudgetMB = 4096;
+	memory = MakeShared<FDtsMemoryTracker>();
+	batchPeakBytes = 0;
 }
 
 
@@ -102,56 +130,319 @@ UObject* UDtsFactory::FactoryCreateFile
 	GEditor->GetEditorSubsystem<UImportSubsystem>()->BroadcastAssetPreImport(this, Class, InParent, Name, Type);
 	Warn->BeginSlowTask(NSLOCTEXT("DtsFactory", "BeginImportingDtsMeshTask", "Importing DTS mesh"), true);
 
+	memory->resetPeaks();
+
+	UObject* CreatedObject = nullptr;
+	if (FileExtension.Equals(TEXT("dsq"), ESearchCase::IgnoreCase))
+	{
+		CreatedObject = importSequenceFile(InParent, Name, Flags, InFilename);
+	}
+	else
+	{
+		FDtsShape Shape;
+		if (readShapeFile(Shape, InFilename))
+		{
+			FDtsMemoryScope ParseScope(*memory, EDtsMemoryStage::Parse, DtsGetShapeBytes(Shape));
+			CreatedObject = createAssets(Shape, InParent, Name, Flags, InFilename);
+			if (!CreatedObject)
+			{
+				UE_LOG(LogDts, Error, TEXT("Can't create assets for file [%s]"), *InFilename);
+			}
+		}
+	}
+
+	UE_LOG(LogDts, Log, TEXT("Memory [%s]: %s"), *InFilename, *memory->describe());
+	// Built assets stay resident until the user saves them, so going over the budget here can only be reported
+	const int64 budgetBytes = int64(SequenceDecodeBudgetMB) * 1024 * 1024;
+	if (SequenceDecodeBudgetMB > 0 && memory->getPeakTotal() > budgetBytes && batchPeakBytes <= budgetBytes)
+	{
+		UE_LOG(LogDts, Warning, TEXT("Import memory high-water mark %.1f MB exceeds SequenceDecodeBudgetMB (%d MB) at [%s], %.1f MB of it built assets; import fewer files at once"),
+			memory->getPeakTotal() / (1024.0 * 1024.0), SequenceDecodeBudgetMB, *InFilename, memory->getCurrent(EDtsMemoryStage::Build) / (1024.0 * 1024.0));
+	}
+	batchPeakBytes = FMath::Max(batchPeakBytes, memory->getPeakTotal());
+
+	Warn->EndSlowTask();
+	GEditor->GetEditorSubsystem<UImportSubsystem>()->BroadcastAssetPostImport(this, CreatedObject);
+	return CreatedObject;
+}
+
+
+bool UDtsFactory::readShapeFile(FDtsShape& shape, const FString& filename)
+{
 	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
-	IFileHandle* FileHandle = PlatformFile.OpenRead(*InFilename);
+	IFileHandle* FileHandle = PlatformFile.OpenRead(*filename);
 	if (!FileHandle)
 	{
-		UE_LOG(LogDts, Error, TEXT("Can't open file [%s]"), *InFilename)
-		Warn->EndSlowTask();
-		GEditor->GetEditorSubsystem<UImportSubsystem>()->BroadcastAssetPostImport(this, nullptr);
-		return nullptr;
+		UE_LOG(LogDts, Error, TEXT("Can't open file [%s]"), *filename)
+		return false;
+	}
+	const int64 FileSize = FileHandle->Size();
+	if (FileSize > int64(StreamingThresholdMB) * 1024 * 1024)
+	{
+		delete FileHandle;
+		// Two windows for each of the three membuffer regions and the tail
+		FDtsMemoryScope WindowScope(*memory, EDtsMemoryStage::FileBuffer, FMath::Min(FileSize, int64(StreamingWindowKB) * 1024 * 2 * 4));
+		if (!parseDtsFile(shape, filename, FileSize, int64(StreamingWindowKB) * 1024))
+		{
+			UE_LOG(LogDts, Error, TEXT("Can't parse file [%s] size [%li]"), *filename, FileSize);
+			return false;
+		}
+		FDtsMemoryScope PeakScope(*memory, EDtsMemoryStage::Parse, DtsGetShapeBytes(shape));	// Peak of windows and decoded shape together
+		return true;
 	}
-	uint8* ByteArray = static_cast<uint8*>(FMemory::Malloc(FileHandle->Size()));
+	uint8* ByteArray = static_cast<uint8*>(FMemory::Malloc(FileSize));
 	if (!ByteArray)
 	{
-		UE_LOG(LogDts, Error, TEXT("Can't allocate memory for file [%s] size [%li]"), *InFilename, FileHandle->Size());
-		Warn->EndSlowTask();
-		GEditor->GetEditorSubsystem<UImportSubsystem>()->BroadcastAssetPostImport(this, nullptr);
-		return nullptr;
+		UE_LOG(LogDts, Error, TEXT("Can't allocate memory for file [%s] size [%li]"), *filename, FileSize);
+		delete FileHandle;
+		return false;
+	}
+	if (!FileHandle->Read(ByteArray, FileSize))
+	{
+		UE_LOG(LogDts, Error, TEXT("Can't read from file [%s] size [%li]"), *filename, FileSize);
+		FMemory::Free(ByteArray);
+		delete FileHandle;
+		return false;
+	}
+	delete FileHandle;
+	FDtsMemoryScope BufferScope(*memory, EDtsMemoryStage::FileBuffer, FileSize);
+	const bool bParsed = parseDtsData(shape, ByteArray, FileSize);
+	{
+		// Registers the peak of buffer and decoded shape together; callers account the shape for as long as they keep it
+		FDtsMemoryScope PeakScope(*memory, EDtsMemoryStage::Parse, DtsGetShapeBytes(shape));
+	}
+	FMemory::Free(ByteArray);
+	if (!bParsed)
+	{
+		UE_LOG(LogDts, Error, TEXT("Can't parse file [%s] size [%li]"), *filename, FileSize);
+		return false;
+	}
+	return true;
+}
+
+
+// Every .dsq of a batch looks for its shape (and siblings) in the same folder, so each folder is listed once
+const TArray<FString>& UDtsFactory::findFiles(const FString& directory, const TCHAR* wildcard)
+{
+	const FString pattern = directory / wildcard;
+	TArray<FString>* files = directoryListings.Find(pattern);
+	if (!files)
+	{
+		files = &directoryListings.Add(pattern);
+		IFileManager::Get().FindFiles(*files, *pattern, true, false);
+	}
+	return *files;
+}
+
+
+FString UDtsFactory::findBaseShape(const FString& sequenceFilename)
+{
+	if (!BaseShapeFile.IsEmpty())
+	{
+		return FPaths::ConvertRelativePathToFull(BaseShapeFile);
 	}
-	if (!FileHandle->Read(ByteArray, FileHandle->Size()))
+	const FString directory = FPaths::GetPath(FPaths::ConvertRelativePathToFull(sequenceFilename));
+	const FString sequenceName = FPaths::GetBaseFilename(sequenceFilename);
+	const TArray<FString>& shapeFiles = findFiles(directory, TEXT("*.dts"));
+	FString best;
+	for (const FString& shapeFile : shapeFiles)
 	{
-		UE_LOG(LogDts, Error, TEXT("Can't read from file [%s] size [%li]"), *InFilename, FileHandle->Size());
-		Warn->EndSlowTask();
-		GEditor->GetEditorSubsystem<UImportSubsystem>()->BroadcastAssetPostImport(this, nullptr);
+		const FString shapeName = FPaths::GetBaseFilename(shapeFile);
+		if (sequenceName.StartsWith(shapeName, ESearchCase::IgnoreCase) && shapeName.Len() > FPaths::GetBaseFilename(best).Len())
+		{
+			best = shapeFile;
+		}
+	}
+	if (best.IsEmpty() && shapeFiles.Num() == 1)
+	{
+		best = shapeFiles[0];
+	}
+	return best.IsEmpty() ? best : directory / best;
+}
+
+
+// Returns the number of files decoded at once: as many as fit in what is left of SequenceDecodeBudgetMB.
+// Decoded shapes stay accounted until their file is imported.
+int32 UDtsFactory::decodeSequenceFiles(const FDtsShape& baseShape, const TArray<FString>& filenames, TArray<TSharedPtr<FDtsShape>>& shapes)
+{
+	shapes.SetNum(filenames.Num());
+	int32 numConcurrent = filenames.Num();
+	if (SequenceDecodeBudgetMB > 0 && filenames.Num() > 0)
+	{
+		int64 fileBytes = 0;
+		for (const FString& filename : filenames)
+		{
+			fileBytes += FMath::Max<int64>(IFileManager::Get().FileSize(*filename), 0);
+		}
+		// File buffer plus decoded keys, which take about three times their size on disk (FQuat is twice a Quat16)
+		const int64 bytesPerFile = FMath::Max<int64>(fileBytes / filenames.Num(), 1) * 4;
+		const int64 available = int64(SequenceDecodeBudgetMB) * 1024 * 1024 - memory->getCurrentTotal();
+		numConcurrent = int32(FMath::Clamp<int64>(available / bytesPerFile, 1, filenames.Num()));
+	}
+	for (auto first = 0; first < filenames.Num(); first += numConcurrent)
+	{
+		ParallelFor(FMath::Min(numConcurrent, filenames.Num() - first), [this, &baseShape, &filenames, &shapes, first](int32 n)
+		{
+			const int32 i = first + n;
+			TArray<uint8> data;
+			if (!FFileHelper::LoadFileToArray(data, *filenames[i]))
+			{
+				UE_LOG(LogDts, Error, TEXT("Can't read from file [%s]"), *filenames[i]);
+				return;
+			}
+			FDtsMemoryScope bufferScope(*memory, EDtsMemoryStage::FileBuffer, data.Num());
+			TSharedPtr<FDtsShape> shape = MakeShared<FDtsShape>();
+			if (!parseDsqData(*shape, baseShape, data.GetData(), data.Num()))
+			{
+				UE_LOG(LogDts, Error, TEXT("Can't parse file [%s] size [%d]"), *filenames[i], data.Num());
+				return;
+			}
+			memory->add(EDtsMemoryStage::Parse, DtsGetShapeBytes(*shape));
+			shapes[i] = shape;
+		});
+	}
+	return numConcurrent;
+}
+
+
+UObject* UDtsFactory::importSequenceFile(UObject* InParent, FName Name, EObjectFlags Flags, const FString& filename)
+{
+	const FString fullFilename = FPaths::ConvertRelativePathToFull(filename);
+	const FString baseFilename = findBaseShape(fullFilename);
+	if (baseFilename.IsEmpty())
+	{
+		UE_LOG(LogDts, Error, TEXT("No base shape found for sequence file [%s], set BaseShapeFile"), *filename);
 		return nullptr;
 	}
-	UObject* CreatedObject = nullptr;
-	if (!parseDtsData(CreatedObject, ByteArray, FileHandle->Size()) || !CreatedObject)
+
+	// Base shapes are parsed once per import batch
+	TSharedPtr<FDtsShape> baseShape = baseShapes.FindRef(baseFilename);
+	if (!baseShape)
+	{
+		baseShape = MakeShared<FDtsShape>();
+		if (!readShapeFile(*baseShape, baseFilename))
+		{
+			return nullptr;
+		}
+		baseShapes.Add(baseFilename, baseShape);
+		memory->add(EDtsMemoryStage::Parse, DtsGetShapeBytes(*baseShape));
+		UE_LOG(LogDts, Log, TEXT("Parsed base shape [%s] (%d nodes) for sequence files"), *baseFilename, int32(baseShape->nodes.size()));
+	}
+
+	TSharedPtr<FDtsShape> sequences;
+	if (!decodedSequenceFiles.RemoveAndCopyValue(fullFilename, sequences))
+	{
+		TArray<FString> filenames = { fullFilename };
+		if (bDecodeSequenceFolder)
+		{
+			const FString directory = FPaths::GetPath(fullFilename);
+			for (const FString& sequenceFile : findFiles(directory, TEXT("*.dsq")))
+			{
+				const FString path = directory / sequenceFile;
+				if (path != fullFilename && !decodedSequenceFiles.Contains(path) && findBaseShape(path) == baseFilename)
+				{
+					filenames.Add(path);
+				}
+			}
+		}
+		const double startTime = FPlatformTime::Seconds();
+		TArray<TSharedPtr<FDtsShape>> decoded;
+		const int32 numConcurrent = decodeSequenceFiles(*baseShape, filenames, decoded);
+		UE_LOG(LogDts, Log, TEXT("Decoded %d sequence files, %d at a time, in %.3f ms"), filenames.Num(), numConcurrent, (FPlatformTime::Seconds() - startTime) * 1000.0);
+		sequences = decoded[0];
+		for (auto i = 1; i < filenames.Num(); i++)
+		{
+			decodedSequenceFiles.Add(filenames[i], decoded[i]);
+		}
+	}
+	if (!sequences)
 	{
-		UE_LOG(LogDts, Error, TEXT("Can't parse file [%s] size [%li]"), *InFilename, FileHandle->Size());
-		Warn->EndSlowTask();
-		GEditor->GetEditorSubsystem<UImportSubsystem>()->BroadcastAssetPostImport(this, nullptr);
 		return nullptr;
 	}
-	FMemory::Free(ByteArray);
-	delete FileHandle;
+	TArray<UAnimSequence*> animSequences = buildAnimSequences(*sequences, InParent, Name, Flags, true);
+	memory->remove(EDtsMemoryStage::Parse, DtsGetShapeBytes(*sequences));
+	addBuiltAssets(animSequences);
+	return animSequences.Num() > 0 ? animSequences[0] : nullptr;
+}
 
-	Warn->EndSlowTask();
-	GEditor->GetEditorSubsystem<UImportSubsystem>()->BroadcastAssetPostImport(this, CreatedObject);
-	return CreatedObject;
+
+UObject* UDtsFactory::createAssets(FDtsShape& shape, UObject* InParent, FName Name, EObjectFlags Flags, const FString& filename)
+{
+	if (bCheckVertexPrecision)
+	{
+		FDtsQuantizeSettings settings;
+		settings.uvErrorBudget = UVErrorBudget;
+		settings.normalErrorBudgetDegrees = NormalErrorBudgetDegrees;
+		TArray<FDtsQuantizeReport> reports;
+		DtsQuantizeShape(shape, settings, reports);
+		int32 numFullUVs = 0;
+		int32 numHighNormals = 0;
+		int64 bytesOverDefault = 0;
+		for (const FDtsQuantizeReport& report : reports)
+		{
+			UE_LOG(LogDts, Verbose, TEXT("Vertex precision [%s] mesh %d: %d verts, UV error %g (%s), normal error %.3f deg (%s), %lld bytes (engine default %lld)"),
+				*filename, report.meshIndex, report.numVerts,
+				report.maxUVError, report.halfUVs ? TEXT("16-bit") : TEXT("32-bit"),
+				report.maxNormalErrorDegrees, report.packedNormals ? TEXT("packed") : TEXT("high precision"),
+				report.bytesChosen, report.bytesDefault);
+			numFullUVs += report.halfUVs ? 0 : 1;
+			numHighNormals += report.packedNormals ? 0 : 1;
+			bytesOverDefault += report.bytesChosen - report.bytesDefault;
+		}
+		UE_LOG(LogDts, Log, TEXT("Vertex precision [%s]: %d meshes checked, %d need full precision UVs, %d high precision normals; %lld vertex bytes over the engine default"),
+			*filename, reports.Num(), numFullUVs, numHighNormals, bytesOverDefault);
+	}
+	if (!materialImporter)
+	{
+		UMaterialInterface* baseMaterial = Cast<UMaterialInterface>(BaseMaterial.TryLoad());
+		materialImporter = MakeShared<FDtsMaterialImporter>(baseMaterial, TextureSearchRoot);
+	}
+	const FString destinationPath = FPackageName::GetLongPackagePath(InParent->GetOutermost()->GetName());
+	TArray<UMaterialInterface*> materials = materialImporter->importMaterials(shape, filename, destinationPath);
+	FDtsDedupStats stats = shape.dedup;
+	UStaticMesh* staticMesh = buildStaticMesh(shape, materials, InParent, Name, Flags, stats);
+	UE_LOG(LogDts, Log, TEXT("Deduplication [%s]: %d parent shared, %d content shared, %d instanced meshes, %d reused LODs, %lld bytes and %.3f ms saved"),
+		*filename, stats.numParentShared, stats.numContentShared, stats.numInstances, stats.numReusedLods, stats.bytesSaved, stats.buildSecondsSaved * 1000.0);
+	if (!shape.sequences.empty())
+	{
+		const double startTime = FPlatformTime::Seconds();
+		const TArray<UAnimSequence*> animSequences = buildAnimSequences(shape, InParent, Name, Flags, false);
+		addBuiltAssets(animSequences);
+		const int32 numSequences = animSequences.Num();
+		UE_LOG(LogDts, Log, TEXT("Sequences [%s]: %d of %d imported in %.3f ms"), *filename, numSequences, int32(shape.sequences.size()), (FPlatformTime::Seconds() - startTime) * 1000.0);
+	}
+	return staticMesh;
+}
+
+
+void UDtsFactory::addBuiltAssets(const TArray<UAnimSequence*>& animSequences)
+{
+	for (UAnimSequence* animSequence : animSequences)
+	{
+		memory->add(EDtsMemoryStage::Build, animSequence->GetResourceSizeBytes(EResourceSizeMode::EstimatedTotal));
+	}
 }
 
 
 void UDtsFactory::CleanUp() 
 {
+	materialImporter.Reset();
+	baseShapes.Empty();
+	directoryListings.Empty();
+	decodedSequenceFiles.Empty();
+	if (batchPeakBytes > 0)
+	{
+		UE_LOG(LogDts, Log, TEXT("Import memory high-water mark %.1f MB, budget %d MB"), batchPeakBytes / (1024.0 * 1024.0), SequenceDecodeBudgetMB);
+	}
+	memory->reset();
+	batchPeakBytes = 0;
 }
 
 
 bool UDtsFactory::FactoryCanImport(const FString& Filename)
 {
 	const FString Extension = FPaths::GetExtension(Filename);
-	if (Extension == TEXT("dts"))
+	if (Extension == TEXT("dts") || Extension == TEXT("dsq"))
 	{
 		return true;
 	}
@@ -7,12 +7,108 @@
 #include "DtsFactory.generated.h"
 
 class IImportSettingsParser;
+class UMaterialInterface;
+class UStaticMesh;
+class UAnimSequence;
+class FDtsStream;
+class FDtsMaterialImporter;
+class FDtsMemoryTracker;
+struct FDtsShape;
+struct FDtsMesh;
+struct FDtsSequence;
+struct FDtsDedupStats;
 
 UCLASS(hidecategories=Object)
 class DTSIMPORT_API UDtsFactory : public UFactory
 {
 	GENERATED_UCLASS_BODY()
 
+	/** Files larger than this (in MB) are parsed through bounded streaming windows instead of one whole-file allocation */
+	UPROPERTY(EditAnywhere, Category = Streaming)
+	int32 StreamingThresholdMB;
+
+	/** Size (in KB) of each of the two read windows per membuffer region when streaming */
+	UPROPERTY(EditAnywhere, Category = Streaming)
+	int32 StreamingWindowKB;
+
+	/** Uniform scale applied to positions (DTS units are meters) */
+	UPROPERTY(EditAnywhere, Category = Mesh)
+	float ImportScale;
+
+	/** Build objects with identical geometry once as a separate mesh and leave them out of the imported mesh. Their placements are recorded as sockets
+	  * whose Tag holds the separate mesh's path; sockets are metadata only, so the objects are drawn only where a level or blueprint spawns the tagged
+	  * mesh at each socket (e.g. as instances of an instanced static mesh component) */
+	UPROPERTY(EditAnywhere, Category = Mesh)
+	bool bInstanceDuplicateMeshes;
+
+	/** Sorted (translucent) meshes get the triangle order Torque draws when viewed from this octant: bit 0 +X, bit 1 +Y, bit 2 +Z */
+	UPROPERTY(EditAnywhere, Category = Mesh, meta = (ClampMin = "0", ClampMax = "7"))
+	int32 SortedMeshViewOctant;
+
+	/** Compute normals and tangents on worker threads while triangulating (MikkTSpace conventions) instead of in the engine's serial mesh build */
+	UPROPERTY(EditAnywhere, Category = Mesh)
+	bool bGenerateTangents;
+
+	/** Keep the normals stored in the file and only generate tangents. Otherwise normals are smoothed over coincident positions */
+	UPROPERTY(EditAnywhere, Category = Mesh, meta = (EditCondition = "bGenerateTangents"))
+	bool bTrustFileNormals;
+
+	/** Measure the error of the engine's default 16-bit UVs and 8-bit packed normals, and switch LODs whose meshes go over
+	  * the error budgets below to full precision UVs / high precision tangents. Off leaves the engine defaults */
+	UPROPERTY(EditAnywhere, Category = Mesh)
+	bool bCheckVertexPrecision;
+
+	/** Largest UV error (in UV units) accepted for 16-bit UVs */
+	UPROPERTY(EditAnywhere, Category = Mesh, meta = (EditCondition = "bCheckVertexPrecision"))
+	float UVErrorBudget;
+
+	/** Largest normal error (in degrees) accepted for packed normals. Only normals are measured; tangents follow the normals' precision */
+	UPROPERTY(EditAnywhere, Category = Mesh, meta = (EditCondition = "bCheckVertexPrecision"))
+	float NormalErrorBudgetDegrees;
+
+	/** Render v26 billboard detail levels into an imposter atlas on worker threads and add it as the last LOD: one quad per equator (and pole) view */
+	UPROPERTY(EditAnywhere, Category = Mesh)
+	bool bGenerateImposters;
+
+	/** Size in pixels of each imposter view. 0 uses the size stored with the billboard detail level */
+	UPROPERTY(EditAnywhere, Category = Mesh, meta = (EditCondition = "bGenerateImposters", ClampMin = "0", ClampMax = "1024"))
+	int32 ImposterTileSize;
+
+	/** Parent of the imposter material instance; the atlas is bound to its DiffuseTexture parameter and it is drawn masked by the atlas alpha.
+	  * Empty, or a material without a DiffuseTexture parameter, creates the masked M_DtsImposter next to the first shape and uses that */
+	UPROPERTY(EditAnywhere, Category = Materials, meta = (AllowedClasses = "MaterialInterface"))
+	FSoftObjectPath ImposterMaterial;
+
+	/** Memory (in MB) the import batch may hold while the .dsq files of a folder are decoded ahead of their import. Only limits how many of them
+	  * are decoded at once: .dts files and built assets are not held back, but the batch's high-water mark is logged against it. 0 means no limit */
+	UPROPERTY(EditAnywhere, Category = Streaming, meta = (ClampMin = "0"))
+	int32 SequenceDecodeBudgetMB;
+
+	/** Parent of the created material instances. DTS textures are bound to its DiffuseTexture/BumpTexture/DetailTexture/ReflectanceTexture parameters.
+	  * Empty, or a material without a DiffuseTexture parameter, creates M_DtsBase next to the first imported shape and uses that */
+	UPROPERTY(EditAnywhere, Category = Materials, meta = (AllowedClasses = "MaterialInterface"))
+	FSoftObjectPath BaseMaterial;
+
+	/** Folder searched for textures named by the material table. Empty means the folder of each imported file */
+	UPROPERTY(EditAnywhere, Category = Materials)
+	FString TextureSearchRoot;
+
+	/** Skeleton animated by the sequences of imported shapes. Ground frames are baked into root motion on its root bone, triggers into notifies. No sequences are imported without it */
+	UPROPERTY(EditAnywhere, Category = Animation, meta = (AllowedClasses = "Skeleton"))
+	FSoftObjectPath Skeleton;
+
+	/** Frames per second at which sequences are resampled */
+	UPROPERTY(EditAnywhere, Category = Animation, meta = (ClampMin = "1"))
+	float AnimSampleRate;
+
+	/** DTS whose nodes .dsq sequence files animate. Empty picks the .dts next to each .dsq whose name is the longest prefix of the .dsq name (or the only one) */
+	UPROPERTY(EditAnywhere, Category = Animation)
+	FString BaseShapeFile;
+
+	/** When a .dsq is imported, decode every .dsq of its folder that uses the same base shape on worker threads, so the rest of the batch finds them ready */
+	UPROPERTY(EditAnywhere, Category = Animation)
+	bool bDecodeSequenceFolder;
+
 	//~ Begin UObject Interface
 	void CleanUp() override;
 	bool ConfigureProperties() override;
@@ -27,12 +123,33 @@ class DTSIMPORT_API UDtsFactory : public UFactory
 	IImportSettingsParser* GetImportSettingsParser() override;
 	//~ End UFactory Interface
 
+	// Also used by the DtsOptimize commandlet
+	bool readShapeFile(FDtsShape& shape, const FString& filename);
+	bool parseDtsData(FDtsShape& shape, uint8* data, int64 dataSize);
+
 private:
-	bool parseDtsData(UObject*& createdObject, uint8* data, int64 dataSize);
-	void parseSequence(uint32_t version, uint8*& data, int64& dataSize);
-	void parseMembuffers(uint32_t version, uint32_t* memBuffer32, uint32_t sizeMemBuffer32, uint16_t* memBuffer16, uint32_t sizeMemBuffer16, uint8_t* memBuffer8, uint32_t sizeMemBuffer8);
-	void parseMesh(uint32_t version, uint32_t& guardValue, uint32_t*& memBuffer32, uint32_t& sizeMemBuffer32, uint16_t*& memBuffer16, uint32_t& sizeMemBuffer16, uint8_t*& memBuffer8, uint32_t& sizeMemBuffer8);
-	
+	bool parseDtsFile(FDtsShape& shape, const FString& filename, int64 fileSize, int64 windowSize);
+	bool parseDtsStreams(FDtsShape& shape, uint32_t version, FDtsStream& memBuffer32, FDtsStream& memBuffer16, FDtsStream& memBuffer8, FDtsStream& data);
+	bool parseDsqData(FDtsShape& shape, const FDtsShape& baseShape, uint8* data, int64 dataSize);
+	void parseSequence(uint32_t version, FDtsSequence& sequence, FDtsStream& data, bool readNameIndex = true);
+	bool parseMembuffers(uint32_t version, FDtsShape& shape, FDtsStream& memBuffer32, FDtsStream& memBuffer16, FDtsStream& memBuffer8);
+	bool parseMesh(uint32_t version, FDtsMesh& mesh, uint32_t& guardValue, FDtsStream& memBuffer32, FDtsStream& memBuffer16, FDtsStream& memBuffer8);
+
+	const TArray<FString>& findFiles(const FString& directory, const TCHAR* wildcard);
+	FString findBaseShape(const FString& sequenceFilename);
+	int32 decodeSequenceFiles(const FDtsShape& baseShape, const TArray<FString>& filenames, TArray<TSharedPtr<FDtsShape>>& shapes);
+	UObject* importSequenceFile(UObject* InParent, FName Name, EObjectFlags Flags, const FString& filename);
+	UObject* createAssets(FDtsShape& shape, UObject* InParent, FName Name, EObjectFlags Flags, const FString& filename);
+	UStaticMesh* buildStaticMesh(const FDtsShape& shape, const TArray<UMaterialInterface*>& materials, UObject* InParent, FName Name, EObjectFlags Flags, FDtsDedupStats& stats);
+	TArray<UAnimSequence*> buildAnimSequences(const FDtsShape& shape, UObject* InParent, FName Name, EObjectFlags Flags, bool bFirstInParent);
+	void addBuiltAssets(const TArray<UAnimSequence*>& animSequences);
+
+	TSharedPtr<FDtsMaterialImporter> materialImporter;	// Texture index and imported textures/materials, shared by the import batch until CleanUp
+	TMap<FString, TSharedPtr<FDtsShape>> baseShapes;		// Parsed base shapes of .dsq files by full path, until CleanUp
+	TMap<FString, TArray<FString>> directoryListings;		// File names matching a wildcard, by directory / wildcard, listed once per batch until CleanUp
+	TMap<FString, TSharedPtr<FDtsShape>> decodedSequenceFiles;	// .dsq files decoded ahead of their import (null if they failed), removed when imported
+	TSharedPtr<FDtsMemoryTracker> memory;				// Bytes held by the import batch, until CleanUp
+	int64 batchPeakBytes;								// Highest total of memory over the batch's imports, reported against SequenceDecodeBudgetMB
 };
 
 DECLARE_LOG_CATEGORY_EXTERN(LogDts, Log, All);
@@ -0,0 +1,377 @@
+
+
+#include "DtsImposter.h"
+#include "DtsBuild.h"
+#include "DtsFactory.h"
+#include "DtsMaterials.h"
+#include "DtsShape.h"
+
+#include "AssetRegistryModule.h"
+#include "Async/ParallelFor.h"
+#include "Engine/Texture2D.h"
+#include "Math/Float16Color.h"
+#include "Materials/MaterialInstanceConstant.h"
+#include "UObject/Package.h"
+
+
+void FDtsImposterAtlas::getTileUVs(int32 view, FVector2D& uvMin, FVector2D& uvMax) const
+{
+	const int32 column = columns > 0 ? view % columns : 0;
+	const int32 row = columns > 0 ? view / columns : 0;
+	uvMin = FVector2D(float(column * tileSize) / width, float(row * tileSize) / height);
+	uvMax = FVector2D(float((column + 1) * tileSize) / width, float((row + 1) * tileSize) / height);
+}
+
+
+void DtsGetImposterViews(const FDtsDetail& billboard, bool includePolarRings, FDtsImposterAtlas& atlas)
+{
+	TArray<FVector>& directions = atlas.viewDirections;
+	const int32 equatorSteps = billboard.bbEquatorSteps > 0 ? FMath::Min<int32>(billboard.bbEquatorSteps, 64) : 4;
+	const int32 polarSteps = includePolarRings ? FMath::Min<int32>(billboard.bbPolarSteps, 16) : 0;
+	// bbPolarAngle is in degrees and is how far short of the poles the outermost rings stop
+	const float polarStep = polarSteps > 0 ? (HALF_PI - FMath::DegreesToRadians(FMath::Clamp(billboard.bbPolarAngle, 0.0f, 90.0f))) / polarSteps : 0.0f;
+	directions.Reset();
+	atlas.firstEquatorView = polarSteps * equatorSteps;
+	atlas.numEquatorViews = equatorSteps;
+	for (auto ring = -polarSteps; ring <= polarSteps; ring++)
+	{
+		const float elevation = ring * polarStep;
+		for (auto step = 0; step < equatorSteps; step++)
+		{
+			const float azimuth = step * 2.0f * PI / equatorSteps;
+			directions.Add(FVector(FMath::Cos(elevation) * FMath::Cos(azimuth), FMath::Cos(elevation) * FMath::Sin(azimuth), FMath::Sin(elevation)));
+		}
+	}
+	atlas.firstPoleView = -1;
+	if (billboard.bbIncludePoles)
+	{
+		atlas.firstPoleView = directions.Num();
+		directions.Add(FVector(0.0f, 0.0f, 1.0f));
+		directions.Add(FVector(0.0f, 0.0f, -1.0f));
+	}
+}
+
+
+namespace
+{
+
+// Triangles of a detail level in shape space, ready to be projected
+struct FDtsImposterGeometry
+{
+	TArray<FVector> positions;
+	TArray<FVector2D> uvs;
+	TArray<int32> triangles;
+	TArray<int32> triangleMaterials;
+};
+
+
+void GatherGeometry(const FDtsShape& shape, const FDtsDetail& detail, FDtsImposterGeometry& geometry)
+{
+	TArray<int32> objectIndices;
+	TArray<int32> meshIndices;
+	DtsGetDetailMeshes(shape, detail, objectIndices, meshIndices);
+	for (auto i = 0; i < meshIndices.Num(); i++)
+	{
+		const FDtsMesh& mesh = shape.meshes[meshIndices[i]];
+		const FDtsMesh& vertexData = shape.getVertexData(meshIndices[i]);
+		const FTransform transform = GetNodeTransform(shape, shape.objects[objectIndices[i]].nodeIndex);
+		const int32 numVerts = FMath::Min<int32>(mesh.vertsPerFrame > 0 ? mesh.vertsPerFrame : vertexData.verts.size(), vertexData.verts.size());
+		const int32 firstVert = geometry.positions.Num();
+		for (auto v = 0; v < numVerts; v++)
+		{
+			geometry.positions.Add(transform.TransformPosition(vertexData.verts[v]));
+			geometry.uvs.Add(v < int32(vertexData.tverts.size()) ? vertexData.tverts[v] : FVector2D::ZeroVector);
+		}
+		TMap<int32, TArray<int32>> trianglesByMaterial;
+		DtsTriangulate(mesh, trianglesByMaterial);
+		for (const auto& pair : trianglesByMaterial)
+		{
+			for (auto t = 0; t + 2 < pair.Value.Num(); t += 3)
+			{
+				if (pair.Value[t] < 0 || pair.Value[t + 1] < 0 || pair.Value[t + 2] < 0 || pair.Value[t] >= numVerts || pair.Value[t + 1] >= numVerts || pair.Value[t + 2] >= numVerts)
+				{
+					continue;
+				}
+				geometry.triangles.Add(firstVert + pair.Value[t]);
+				geometry.triangles.Add(firstVert + pair.Value[t + 1]);
+				geometry.triangles.Add(firstVert + pair.Value[t + 2]);
+				geometry.triangleMaterials.Add(pair.Key);
+			}
+		}
+	}
+}
+
+
+FColor Sample(const FDtsImposterTexture* texture, const FVector2D& uv)
+{
+	if (!texture || texture->pixels.Num() == 0)
+	{
+		return FColor(128, 128, 128, 255);
+	}
+	float u = uv.X;
+	float v = uv.Y;
+	if (texture->wrap)
+	{
+		u -= FMath::FloorToFloat(u);
+		v -= FMath::FloorToFloat(v);
+	}
+	const int32 x = FMath::Clamp(int32(u * texture->width), 0, texture->width - 1);
+	const int32 y = FMath::Clamp(int32(v * texture->height), 0, texture->height - 1);
+	return texture->pixels[y * texture->width + x];
+}
+
+
+// Orthographic view of the geometry into one tile. Both faces are drawn, nearest texel wins the depth test.
+void RenderView(const FDtsImposterGeometry& geometry, const TArray<FDtsImposterTexture>& textures, const FVector& direction, int32 view, FDtsImposterAtlas& atlas)
+{
+	const int32 tile = atlas.tileSize;
+	const FVector forward = -direction;
+	const FVector up = FMath::Abs(direction.Z) > 0.999f ? FVector(1.0f, 0.0f, 0.0f) : FVector(0.0f, 0.0f, 1.0f);
+	const FVector right = FVector::CrossProduct(forward, up).GetSafeNormal();
+	const FVector screenUp = FVector::CrossProduct(right, forward);
+	const float toPixels = 0.5f * tile / atlas.radius;
+
+	TArray<FVector> projected;									// x, y in pixels, z nearness
+	projected.SetNumUninitialized(geometry.positions.Num());
+	for (auto i = 0; i < geometry.positions.Num(); i++)
+	{
+		const FVector p = geometry.positions[i] - atlas.center;
+		projected[i] = FVector(0.5f * tile + FVector::DotProduct(p, right) * toPixels, 0.5f * tile - FVector::DotProduct(p, screenUp) * toPixels, FVector::DotProduct(p, direction));
+	}
+
+	TArray<float> depth;
+	depth.Init(-MAX_FLT, tile * tile);
+	TArray<FColor> color;
+	color.Init(FColor(0, 0, 0, 0), tile * tile);
+	TBitArray<> filled(false, tile * tile);
+	for (auto t = 0; t < geometry.triangleMaterials.Num(); t++)
+	{
+		const int32 i0 = geometry.triangles[t * 3];
+		const int32 i1 = geometry.triangles[t * 3 + 1];
+		const int32 i2 = geometry.triangles[t * 3 + 2];
+		const FVector& a = projected[i0];
+		const FVector& b = projected[i1];
+		const FVector& c = projected[i2];
+		const float area = (b.X - a.X) * (c.Y - a.Y) - (b.Y - a.Y) * (c.X - a.X);
+		if (FMath::Abs(area) < SMALL_NUMBER)
+		{
+			continue;
+		}
+		const int32 material = geometry.triangleMaterials[t];
+		const FDtsImposterTexture* texture = material >= 0 && material < textures.Num() ? &textures[material] : nullptr;
+		const int32 minX = FMath::Max(FMath::FloorToInt(FMath::Min3(a.X, b.X, c.X)), 0);
+		const int32 maxX = FMath::Min(FMath::CeilToInt(FMath::Max3(a.X, b.X, c.X)), tile - 1);
+		const int32 minY = FMath::Max(FMath::FloorToInt(FMath::Min3(a.Y, b.Y, c.Y)), 0);
+		const int32 maxY = FMath::Min(FMath::CeilToInt(FMath::Max3(a.Y, b.Y, c.Y)), tile - 1);
+		const float invArea = 1.0f / area;
+		for (auto y = minY; y <= maxY; y++)
+		{
+			for (auto x = minX; x <= maxX; x++)
+			{
+				const float px = x + 0.5f;
+				const float py = y + 0.5f;
+				const float w0 = ((b.X - px) * (c.Y - py) - (b.Y - py) * (c.X - px)) * invArea;
+				const float w1 = ((c.X - px) * (a.Y - py) - (c.Y - py) * (a.X - px)) * invArea;
+				const float w2 = 1.0f - w0 - w1;
+				if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+				{
+					continue;
+				}
+				const float z = w0 * a.Z + w1 * b.Z + w2 * c.Z;
+				const int32 pixel = y * tile + x;
+				if (z <= depth[pixel])
+				{
+					continue;
+				}
+				FColor texel = Sample(texture, geometry.uvs[i0] * w0 + geometry.uvs[i1] * w1 + geometry.uvs[i2] * w2);
+				if (texture && texture->alphaTest && texel.A < 128)
+				{
+					continue;
+				}
+				texel.A = 255;
+				depth[pixel] = z;
+				color[pixel] = texel;
+				filled[pixel] = true;
+			}
+		}
+	}
+
+	// Spread edge colors into empty texels (alpha stays 0) so filtering and mips don't pull in black
+	for (auto pass = 0; pass < 2; pass++)
+	{
+		TArray<FColor> dilated = color;
+		TBitArray<> dilatedFilled = filled;
+		for (auto y = 0; y < tile; y++)
+		{
+			for (auto x = 0; x < tile; x++)
+			{
+				if (filled[y * tile + x])
+				{
+					continue;
+				}
+				int32 sum[3] = { 0, 0, 0 };
+				int32 count = 0;
+				for (auto ny = FMath::Max(y - 1, 0); ny <= FMath::Min(y + 1, tile - 1); ny++)
+				{
+					for (auto nx = FMath::Max(x - 1, 0); nx <= FMath::Min(x + 1, tile - 1); nx++)
+					{
+						if (filled[ny * tile + nx])
+						{
+							const FColor& neighbor = color[ny * tile + nx];
+							sum[0] += neighbor.R;
+							sum[1] += neighbor.G;
+							sum[2] += neighbor.B;
+							count++;
+						}
+					}
+				}
+				if (count > 0)
+				{
+					dilated[y * tile + x] = FColor(sum[0] / count, sum[1] / count, sum[2] / count, 0);
+					dilatedFilled[y * tile + x] = true;
+				}
+			}
+		}
+		color = MoveTemp(dilated);
+		filled = MoveTemp(dilatedFilled);
+	}
+
+	const int32 originX = (view % atlas.columns) * tile;
+	const int32 originY = (view / atlas.columns) * tile;
+	for (auto y = 0; y < tile; y++)
+	{
+		FMemory::Memcpy(&atlas.pixels[(originY + y) * atlas.width + originX], &color[y * tile], tile * sizeof(FColor));
+	}
+}
+
+}
+
+
+bool DtsRenderImposters(const FDtsShape& shape, const FDtsDetail& billboard, const TArray<FDtsImposterTexture>& textures, int32 tileSize, FDtsImposterAtlas& atlas)
+{
+	if (billboard.bbDetailLevel < 0 || billboard.bbDetailLevel >= int32(shape.details.size()))
+	{
+		return false;
+	}
+	FDtsImposterGeometry geometry;
+	GatherGeometry(shape, shape.details[billboard.bbDetailLevel], geometry);
+	if (geometry.triangleMaterials.Num() == 0)
+	{
+		return false;
+	}
+
+	const FBox bounds(geometry.positions);
+	atlas.center = bounds.GetCenter();
+	atlas.radius = 0.0f;
+	for (const FVector& position : geometry.positions)
+	{
+		atlas.radius = FMath::Max(atlas.radius, FVector::Dist(position, atlas.center));
+	}
+	if (atlas.radius <= 0.0f)
+	{
+		return false;
+	}
+
+	// The LOD's quads only show the equator and pole views, so the polar rings are not rendered
+	DtsGetImposterViews(billboard, false, atlas);
+	const int32 numViews = atlas.viewDirections.Num();
+	atlas.tileSize = FMath::Clamp(tileSize > 0 ? tileSize : (billboard.bbDimension > 0 ? billboard.bbDimension : 64), 8, 1024);
+	atlas.columns = FMath::CeilToInt(FMath::Sqrt(float(numViews)));
+	const int32 rows = (numViews + atlas.columns - 1) / atlas.columns;
+	atlas.width = FMath::RoundUpToPowerOfTwo(atlas.columns * atlas.tileSize);
+	atlas.height = FMath::RoundUpToPowerOfTwo(rows * atlas.tileSize);
+	atlas.pixels.Init(FColor(0, 0, 0, 0), atlas.width * atlas.height);
+
+	// Views write disjoint tiles
+	ParallelFor(numViews, [&](int32 view)
+	{
+		RenderView(geometry, textures, atlas.viewDirections[view], view, atlas);
+	});
+	return true;
+}
+
+
+void DtsReadImposterTextures(const FDtsShape& shape, const TArray<UMaterialInterface*>& materials, TArray<FDtsImposterTexture>& textures)
+{
+	textures.SetNum(shape.materials.size());
+	for (auto num = 0; num < textures.Num(); num++)
+	{
+		FDtsImposterTexture& out = textures[num];
+		const uint32_t flags = shape.materials[num].flags;
+		out.wrap = (flags & (MaterialSWrap | MaterialTWrap)) != 0;
+		out.alphaTest = (flags & MaterialTranslucent) != 0;
+		UTexture* texture = nullptr;
+		if (num >= materials.Num() || !materials[num] || !materials[num]->GetTextureParameterValue(FMaterialParameterInfo(FDtsMaterialImporter::DiffuseTextureParam), texture))
+		{
+			continue;
+		}
+		UTexture2D* texture2D = Cast<UTexture2D>(texture);
+		if (!texture2D || !texture2D->Source.IsValid())
+		{
+			continue;
+		}
+		// Source data is always uncompressed (DDS files are decoded on import), but not always 8-bit
+		FTextureSource& source = texture2D->Source;
+		const ETextureSourceFormat format = source.GetFormat();
+		if (format != TSF_BGRA8 && format != TSF_G8 && format != TSF_RGBA16 && format != TSF_RGBA16F && format != TSF_BGRE8)
+		{
+			UE_LOG(LogDts, Warning, TEXT("Can't read source format %d of [%s] for imposters, material %d renders gray"), int32(format), *texture2D->GetPathName(), num);
+			continue;
+		}
+		out.width = source.GetSizeX();
+		out.height = source.GetSizeY();
+		out.pixels.SetNumUninitialized(out.width * out.height);
+		const uint8* data = source.LockMip(0);
+		for (auto i = 0; i < out.pixels.Num(); i++)
+		{
+			switch (format)
+			{
+			case TSF_BGRA8:
+				out.pixels[i] = reinterpret_cast<const FColor*>(data)[i];
+				break;
+			case TSF_G8:
+				out.pixels[i] = FColor(data[i], data[i], data[i], 255);
+				break;
+			case TSF_RGBA16:
+			{
+				const uint16* texel = reinterpret_cast<const uint16*>(data) + i * 4;
+				out.pixels[i] = FColor(texel[0] >> 8, texel[1] >> 8, texel[2] >> 8, texel[3] >> 8);
+				break;
+			}
+			case TSF_RGBA16F:
+				out.pixels[i] = FLinearColor(reinterpret_cast<const FFloat16Color*>(data)[i]).ToFColor(true);
+				break;
+			default:
+				out.pixels[i] = reinterpret_cast<const FColor*>(data)[i].FromRGBE().ToFColor(true);
+				break;
+			}
+		}
+		source.UnlockMip(0);
+	}
+}
+
+
+UMaterialInterface* DtsCreateImposterMaterial(const FDtsImposterAtlas& atlas, UMaterialInterface* parentMaterial, const FString& destinationPath, const FString& assetName)
+{
+	const FString textureName = TEXT("T_") + assetName;
+	UPackage* texturePackage = CreatePackage(nullptr, *(destinationPath / TEXT("Textures") / textureName));
+	UTexture2D* texture = NewObject<UTexture2D>(texturePackage, *textureName, RF_Public | RF_Standalone);
+	texture->Source.Init(atlas.width, atlas.height, 1, 1, TSF_BGRA8, reinterpret_cast<const uint8*>(atlas.pixels.GetData()));
+	texture->AddressX = TA_Clamp;
+	texture->AddressY = TA_Clamp;
+	texture->PostEditChange();
+	FAssetRegistryModule::AssetCreated(texture);
+	texturePackage->MarkPackageDirty();
+
+	const FString materialName = TEXT("MI_") + assetName;
+	UPackage* materialPackage = CreatePackage(nullptr, *(destinationPath / materialName));
+	UMaterialInstanceConstant* instance = NewObject<UMaterialInstanceConstant>(materialPackage, *materialName, RF_Public | RF_Standalone);
+	instance->SetParentEditorOnly(parentMaterial);
+	instance->SetTextureParameterValueEditorOnly(FMaterialParameterInfo(FDtsMaterialImporter::DiffuseTextureParam), texture);
+	instance->BasePropertyOverrides.bOverride_BlendMode = true;
+	instance->BasePropertyOverrides.BlendMode = BLEND_Masked;
+	instance->PostEditChange();
+	FAssetRegistryModule::AssetCreated(instance);
+	materialPackage->MarkPackageDirty();
+	return instance;
+}
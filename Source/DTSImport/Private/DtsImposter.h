@@ -0,0 +1,59 @@
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UMaterialInterface;
+class UTexture2D;
+struct FDtsShape;
+struct FDtsDetail;
+
+
+// CPU copy of a material's diffuse texture, sampled by the imposter rasterizer
+struct FDtsImposterTexture
+{
+	int32 width = 0;
+	int32 height = 0;
+	TArray<FColor> pixels;					// Empty if the material has no readable texture; it renders flat gray then
+	bool wrap = true;
+	bool alphaTest = false;					// Translucent materials: texels below half alpha are not drawn
+};
+
+
+// Views of a billboard detail level rendered into one texture, tile per view
+struct FDtsImposterAtlas
+{
+	int32 tileSize = 0;
+	int32 columns = 0;
+	int32 width = 0;
+	int32 height = 0;
+	TArray<FColor> pixels;					// BGRA, alpha is coverage
+	FVector center = FVector::ZeroVector;	// DTS space; every tile spans center +- radius
+	float radius = 0.0f;
+	TArray<FVector> viewDirections;			// Per tile, from the shape toward the viewer (DTS space)
+	int32 firstEquatorView = 0;				// Ring of equatorSteps views around Z at zero elevation
+	int32 numEquatorViews = 0;
+	int32 firstPoleView = -1;				// Top then bottom, -1 without poles
+
+	// UV rectangle of a tile: min, max
+	void getTileUVs(int32 view, FVector2D& uvMin, FVector2D& uvMax) const;
+};
+
+
+// Torque's billboard views: rings of bbEquatorSteps directions around Z at bbPolarSteps elevations above and below
+// the equator, stepping by (90 - bbPolarAngle degrees) / bbPolarSteps, then the poles if bbIncludePoles.
+// Without includePolarRings only the equator ring and the poles are kept. Fills the view fields of atlas.
+void DtsGetImposterViews(const FDtsDetail& billboard, bool includePolarRings, FDtsImposterAtlas& atlas);
+
+// Renders the detail level billboard.bbDetailLevel on worker threads, one view per task, from the views the imposter LOD
+// shows: the equator ring and the poles. textures has one entry per shape material. tileSize overrides bbDimension when > 0.
+bool DtsRenderImposters(const FDtsShape& shape, const FDtsDetail& billboard, const TArray<FDtsImposterTexture>& textures, int32 tileSize, FDtsImposterAtlas& atlas);
+
+// Reads the DiffuseTexture parameter of each material into CPU memory, from the texture's uncompressed source data.
+// Materials whose texture source can't be read render flat gray. Must run on the game thread.
+void DtsReadImposterTextures(const FDtsShape& shape, const TArray<UMaterialInterface*>& materials, TArray<FDtsImposterTexture>& textures);
+
+// Creates the atlas texture and a masked instance of parentMaterial showing it, in packages next to destinationPath/assetName.
+// parentMaterial must have a DiffuseTexture parameter whose alpha drives the opacity mask (see DtsCreateBaseMaterial).
+UMaterialInterface* DtsCreateImposterMaterial(const FDtsImposterAtlas& atlas, UMaterialInterface* parentMaterial, const FString& destinationPath, const FString& assetName);
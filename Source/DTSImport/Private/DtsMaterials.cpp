@@ -0,0 +1,328 @@
+
+
+#include "DtsMaterials.h"
+#include "DtsShape.h"
+#include "DtsFactory.h"
+
+#include "AssetRegistryModule.h"
+#include "EditorFramework/AssetImportData.h"
+#include "Engine/Texture2D.h"
+#include "Factories/TextureFactory.h"
+#include "HAL/FileManager.h"
+#include "Materials/Material.h"
+#include "Materials/MaterialExpressionTextureSampleParameter2D.h"
+#include "Materials/MaterialInstanceConstant.h"
+#include "Misc/FeedbackContext.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "ObjectTools.h"
+#include "UObject/Package.h"
+
+
+const FName FDtsMaterialImporter::DiffuseTextureParam(TEXT("DiffuseTexture"));
+const FName FDtsMaterialImporter::BumpTextureParam(TEXT("BumpTexture"));
+const FName FDtsMaterialImporter::DetailTextureParam(TEXT("DetailTexture"));
+const FName FDtsMaterialImporter::ReflectanceTextureParam(TEXT("ReflectanceTexture"));
+const FName FDtsMaterialImporter::DetailScaleParam(TEXT("DetailScale"));
+const FName FDtsMaterialImporter::ReflectanceParam(TEXT("Reflectance"));
+
+
+static bool IsTextureExtension(const FString& extension)
+{
+	return extension == TEXT("png") || extension == TEXT("jpg") || extension == TEXT("jpeg") || extension == TEXT("bmp") || extension == TEXT("tga") || extension == TEXT("dds");
+}
+
+
+bool DtsHasTextureParameter(UMaterialInterface* material, const FName& param)
+{
+	if (!material)
+	{
+		return false;
+	}
+	TArray<FMaterialParameterInfo> infos;
+	TArray<FGuid> ids;
+	material->GetAllTextureParameterInfo(infos, ids);
+	return infos.ContainsByPredicate([&](const FMaterialParameterInfo& info) { return info.Name == param; });
+}
+
+
+UMaterial* DtsCreateBaseMaterial(const FString& destinationPath, const FString& assetName, bool masked)
+{
+	const FString packageName = destinationPath / assetName;
+	if (UMaterial* existing = LoadObject<UMaterial>(nullptr, *(packageName + TEXT(".") + assetName), nullptr, LOAD_NoWarn | LOAD_Quiet))
+	{
+		return existing;
+	}
+	UPackage* package = CreatePackage(nullptr, *packageName);
+	UMaterial* material = NewObject<UMaterial>(package, *assetName, RF_Public | RF_Standalone);
+
+	UMaterialExpressionTextureSampleParameter2D* diffuse = NewObject<UMaterialExpressionTextureSampleParameter2D>(material);
+	diffuse->ParameterName = FDtsMaterialImporter::DiffuseTextureParam;
+	diffuse->Texture = LoadObject<UTexture2D>(nullptr, TEXT("/Engine/EngineResources/DefaultTexture.DefaultTexture"));
+	diffuse->MaterialExpressionEditorX = -300;
+	material->Expressions.Add(diffuse);
+	material->BaseColor.Connect(0, diffuse);		// RGB
+	material->Opacity.Connect(4, diffuse);			// A, used by instances overridden to a translucent blend mode
+	material->OpacityMask.Connect(4, diffuse);
+	material->BlendMode = masked ? BLEND_Masked : BLEND_Opaque;
+	material->TwoSided = masked;
+
+	material->PostEditChange();
+	FAssetRegistryModule::AssetCreated(material);
+	package->MarkPackageDirty();
+	UE_LOG(LogDts, Log, TEXT("Created parent material [%s]"), *packageName);
+	return material;
+}
+
+
+FDtsTextureIndex::FDtsTextureIndex(const FString& inRoot)
+	: root(inRoot)
+{
+	const double startTime = FPlatformTime::Seconds();
+	TArray<FString> files;
+	IFileManager::Get().FindFilesRecursive(files, *root, TEXT("*.*"), true, false);
+	for (const FString& file : files)
+	{
+		if (IsTextureExtension(FPaths::GetExtension(file).ToLower()))
+		{
+			index.FindOrAdd(FPaths::GetBaseFilename(file).ToLower()).Add(file);
+		}
+	}
+	UE_LOG(LogDts, Log, TEXT("Indexed %d texture names under [%s] in %.3f s"), index.Num(), *root, FPlatformTime::Seconds() - startTime);
+}
+
+
+FString FDtsTextureIndex::find(const FString& textureName, const FString& nearDirectory) const
+{
+	const TArray<FString>* candidates = index.Find(FPaths::GetBaseFilename(textureName).ToLower());
+	if (!candidates)
+	{
+		return FString();
+	}
+	// Torque resolves material names relative to the shape first, so prefer the candidate sharing the longest directory prefix
+	const FString* best = &(*candidates)[0];
+	int32 bestPrefix = -1;
+	for (const FString& candidate : *candidates)
+	{
+		const FString directory = FPaths::GetPath(candidate);
+		int32 prefix = 0;
+		while (prefix < directory.Len() && prefix < nearDirectory.Len() && FChar::ToLower(directory[prefix]) == FChar::ToLower(nearDirectory[prefix]))
+		{
+			prefix++;
+		}
+		if (prefix > bestPrefix)
+		{
+			best = &candidate;
+			bestPrefix = prefix;
+		}
+	}
+	return *best;
+}
+
+
+FDtsMaterialImporter::FDtsMaterialImporter(UMaterialInterface* inBaseMaterial, const FString& inTextureSearchRoot)
+	: baseMaterial(inBaseMaterial)
+	, textureSearchRoot(inTextureSearchRoot)
+{
+}
+
+
+const FDtsTextureIndex& FDtsMaterialImporter::getIndex(const FString& sourceFilename)
+{
+	FString root = textureSearchRoot.IsEmpty() ? FPaths::GetPath(sourceFilename) : textureSearchRoot;
+	FPaths::NormalizeDirectoryName(root);
+	TUniquePtr<FDtsTextureIndex>& index = indices.FindOrAdd(root);
+	if (!index)
+	{
+		index = MakeUnique<FDtsTextureIndex>(root);
+	}
+	return *index;
+}
+
+
+UMaterialInterface* FDtsMaterialImporter::getBaseMaterial(const FString& destinationPath)
+{
+	if (!baseMaterialChecked)
+	{
+		baseMaterialChecked = true;
+		if (baseMaterial && !DtsHasTextureParameter(baseMaterial, DiffuseTextureParam))
+		{
+			UE_LOG(LogDts, Warning, TEXT("Base material [%s] has no %s parameter, using a generated parent instead"), *baseMaterial->GetPathName(), *DiffuseTextureParam.ToString());
+			baseMaterial = nullptr;
+		}
+		if (!baseMaterial)
+		{
+			baseMaterial = DtsCreateBaseMaterial(destinationPath, TEXT("M_DtsBase"), false);
+		}
+	}
+	return baseMaterial;
+}
+
+
+UTexture* FDtsMaterialImporter::importTexture(const FString& textureName, const FString& sourceFilename, const FString& destinationPath, bool clampX, bool clampY)
+{
+	const FString path = getIndex(sourceFilename).find(textureName, FPaths::GetPath(sourceFilename));
+	if (path.IsEmpty())
+	{
+		if (!missingTextures.Contains(textureName))
+		{
+			UE_LOG(LogDts, Warning, TEXT("Can't find texture [%s] for [%s]"), *textureName, *sourceFilename);
+			missingTextures.Add(textureName);
+		}
+		return nullptr;
+	}
+	// The address mode is part of the asset, so a texture used both wrapped and clamped is imported twice
+	const TTuple<FString, bool, bool> key(path, clampX, clampY);
+	if (UTexture** found = textures.Find(key))
+	{
+		return *found;
+	}
+
+	const FString baseName = FPaths::GetBaseFilename(path) + (clampX && clampY ? TEXT("_Clamp") : clampX ? TEXT("_ClampU") : clampY ? TEXT("_ClampV") : TEXT(""));
+	FString assetName = ObjectTools::SanitizeObjectName(baseName);
+	FString packageName = destinationPath / TEXT("Textures") / assetName;
+	UTexture* texture = LoadObject<UTexture>(nullptr, *(packageName + TEXT(".") + assetName), nullptr, LOAD_NoWarn | LOAD_Quiet);
+	const FString* claimedBy = textureSources.Find(packageName);
+	const FString existingSource = texture && texture->AssetImportData ? texture->AssetImportData->GetFirstFilename() : FString();
+	if (claimedBy ? !FPaths::IsSamePath(*claimedBy, path) : !existingSource.IsEmpty() && !FPaths::IsSamePath(existingSource, path))
+	{
+		// A texture of the same name from another folder owns the asset, tell them apart by a hash of the source path
+		assetName = ObjectTools::SanitizeObjectName(baseName + FString::Printf(TEXT("_%08X"), FCrc::StrCrc32(*path.ToLower())));
+		UE_LOG(LogDts, Log, TEXT("Texture [%s] has the same name as [%s], importing it as [%s]"), *path, claimedBy ? **claimedBy : *existingSource, *assetName);
+		packageName = destinationPath / TEXT("Textures") / assetName;
+		texture = LoadObject<UTexture>(nullptr, *(packageName + TEXT(".") + assetName), nullptr, LOAD_NoWarn | LOAD_Quiet);
+	}
+	textureSources.Add(packageName, path);
+	if (!texture)
+	{
+		TArray<uint8> data;
+		if (!FFileHelper::LoadFileToArray(data, *path))
+		{
+			UE_LOG(LogDts, Warning, TEXT("Can't read texture [%s]"), *path);
+			textures.Add(key, nullptr);
+			return nullptr;
+		}
+		UPackage* package = CreatePackage(nullptr, *packageName);
+		UTextureFactory* textureFactory = NewObject<UTextureFactory>();
+		textureFactory->SuppressImportOverwriteDialog();
+		const uint8* bufferStart = data.GetData();
+		texture = Cast<UTexture>(textureFactory->FactoryCreateBinary(UTexture2D::StaticClass(), package, *assetName, RF_Public | RF_Standalone, nullptr,
+			*FPaths::GetExtension(path), bufferStart, bufferStart + data.Num(), GWarn));
+		if (UTexture2D* texture2D = Cast<UTexture2D>(texture))
+		{
+			texture2D->AddressX = clampX ? TA_Clamp : TA_Wrap;
+			texture2D->AddressY = clampY ? TA_Clamp : TA_Wrap;
+			texture2D->AssetImportData->Update(path);
+			texture2D->PostEditChange();
+			FAssetRegistryModule::AssetCreated(texture2D);
+			package->MarkPackageDirty();
+		}
+	}
+	textures.Add(key, texture);
+	return texture;
+}
+
+
+// Everything of a DTS material that ends up in its instance, so same-named materials that differ get their own asset
+static uint32 GetMaterialSignature(const FDtsShape& shape, const FDtsMaterial& material)
+{
+	auto mapName = [&](int32_t mapIndex)
+	{
+		return mapIndex >= 0 && mapIndex < int32(shape.materials.size()) ? FString(UTF8_TO_TCHAR(shape.materials[mapIndex].name.c_str())).ToLower() : FString();
+	};
+	const uint32 flags = material.flags & (MaterialSWrap | MaterialTWrap | MaterialTranslucent | MaterialAdditive | MaterialSubtractive | MaterialSelfIlluminating);
+	const FString description = FString::Printf(TEXT("%u|%s|%s|%s|%g|%g"), flags, *mapName(material.bumpMap), *mapName(material.detailMap), *mapName(material.reflectanceMap),
+		material.detailMap >= 0 ? material.detailScale : 0.0f, material.reflectance);
+	return FCrc::StrCrc32(*description);
+}
+
+
+void FDtsMaterialImporter::setupMaterial(UMaterialInstanceConstant* instance, const FDtsShape& shape, const FDtsMaterial& material, const FString& sourceFilename, const FString& destinationPath)
+{
+	instance->SetParentEditorOnly(getBaseMaterial(destinationPath));
+	instance->ClearParameterValuesEditorOnly();
+
+	const bool clampX = (material.flags & MaterialSWrap) == 0;
+	const bool clampY = (material.flags & MaterialTWrap) == 0;
+	auto setTexture = [&](const FName& param, int32_t mapIndex, const FString& textureName)
+	{
+		if (mapIndex >= int32(shape.materials.size()))
+		{
+			return;
+		}
+		const FString name = mapIndex >= 0 ? FString(UTF8_TO_TCHAR(shape.materials[mapIndex].name.c_str())) : textureName;
+		if (UTexture* texture = importTexture(name, sourceFilename, destinationPath, clampX, clampY))
+		{
+			instance->SetTextureParameterValueEditorOnly(FMaterialParameterInfo(param), texture);
+		}
+	};
+	setTexture(DiffuseTextureParam, -1, UTF8_TO_TCHAR(material.name.c_str()));
+	if (material.bumpMap >= 0)
+	{
+		setTexture(BumpTextureParam, material.bumpMap, FString());
+	}
+	if (material.detailMap >= 0)
+	{
+		setTexture(DetailTextureParam, material.detailMap, FString());
+		instance->SetScalarParameterValueEditorOnly(FMaterialParameterInfo(DetailScaleParam), material.detailScale);
+	}
+	if (material.reflectanceMap >= 0)
+	{
+		setTexture(ReflectanceTextureParam, material.reflectanceMap, FString());
+	}
+	instance->SetScalarParameterValueEditorOnly(FMaterialParameterInfo(ReflectanceParam), material.reflectance);
+
+	instance->BasePropertyOverrides.bOverride_BlendMode = (material.flags & (MaterialTranslucent | MaterialAdditive | MaterialSubtractive)) != 0;
+	instance->BasePropertyOverrides.BlendMode = (material.flags & MaterialAdditive) ? BLEND_Additive : (material.flags & MaterialSubtractive) ? BLEND_Modulate : BLEND_Translucent;
+	instance->BasePropertyOverrides.bOverride_ShadingModel = (material.flags & MaterialSelfIlluminating) != 0;
+	instance->BasePropertyOverrides.ShadingModel = MSM_Unlit;
+	instance->PostEditChange();
+}
+
+
+TArray<UMaterialInterface*> FDtsMaterialImporter::importMaterials(const FDtsShape& shape, const FString& sourceFilename, const FString& destinationPath)
+{
+	TArray<UMaterialInterface*> out;
+	out.SetNumZeroed(shape.materials.size());
+	for (auto num = 0; num < int32(shape.materials.size()); num++)
+	{
+		const FDtsMaterial& material = shape.materials[num];
+		if (material.flags & MaterialAuxiliaryMap)
+		{
+			continue;
+		}
+		const FString materialName = UTF8_TO_TCHAR(material.name.c_str());
+		FString assetName = ObjectTools::SanitizeObjectName(TEXT("MI_") + FPaths::GetBaseFilename(materialName));
+		const uint32 signature = GetMaterialSignature(shape, material);
+		const uint32& firstSignature = materialSignatures.FindOrAdd(assetName, signature);
+		if (firstSignature != signature)
+		{
+			UE_LOG(LogDts, Log, TEXT("Material [%s] of [%s] differs from an earlier material of the same name, importing it as [%s_%08X]"), *materialName, *sourceFilename, *assetName, signature);
+			assetName += FString::Printf(TEXT("_%08X"), signature);
+		}
+		const FString packageName = destinationPath / assetName;
+		if (UMaterialInterface** found = materials.Find(packageName))
+		{
+			out[num] = *found;
+			continue;
+		}
+
+		// Existing instances are set up again, so reimporting picks up changed flags and maps
+		UMaterialInstanceConstant* instance = LoadObject<UMaterialInstanceConstant>(nullptr, *(packageName + TEXT(".") + assetName), nullptr, LOAD_NoWarn | LOAD_Quiet);
+		const bool created = instance == nullptr;
+		if (created)
+		{
+			UPackage* package = CreatePackage(nullptr, *packageName);
+			instance = NewObject<UMaterialInstanceConstant>(package, *assetName, RF_Public | RF_Standalone);
+		}
+		setupMaterial(instance, shape, material, sourceFilename, destinationPath);
+		if (created)
+		{
+			FAssetRegistryModule::AssetCreated(instance);
+		}
+		instance->MarkPackageDirty();
+		materials.Add(packageName, instance);
+		out[num] = instance;
+	}
+	return out;
+}
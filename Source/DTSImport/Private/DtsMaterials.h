@@ -0,0 +1,77 @@
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UMaterial;
+class UMaterialInterface;
+class UMaterialInstanceConstant;
+class UTexture;
+struct FDtsShape;
+struct FDtsMaterial;
+
+
+// True if the material exposes a texture parameter with that name
+bool DtsHasTextureParameter(UMaterialInterface* material, const FName& param);
+
+// Loads or creates the plugin's parent material at destinationPath/assetName: a DiffuseTexture parameter drives base color and opacity,
+// and masked materials clip on its alpha. Used when no parent with a DiffuseTexture parameter is configured.
+UMaterial* DtsCreateBaseMaterial(const FString& destinationPath, const FString& assetName, bool masked);
+
+
+// Basename -> path index of every image under a source root.
+// Built once per root and shared by every shape in an import batch, so resolving texture names never touches the file system.
+class FDtsTextureIndex
+{
+public:
+	explicit FDtsTextureIndex(const FString& root);
+
+	// Resolves a DTS texture name (usually a basename without extension) to a file, preferring the one closest to nearDirectory.
+	// Returns an empty string if nothing matches.
+	FString find(const FString& textureName, const FString& nearDirectory) const;
+
+	const FString& getRoot() const { return root; }
+	int32 num() const { return index.Num(); }
+
+private:
+	FString root;
+	TMap<FString, TArray<FString>> index;	// lower case basename -> full paths
+};
+
+
+// Creates material instances for DTS material tables. Keeps the texture index, imported textures and created
+// material instances for the lifetime of an import batch so that shapes sharing textures import each texture once.
+class FDtsMaterialImporter
+{
+public:
+	// Parameters of the parent material that the DTS material table is mapped to
+	static const FName DiffuseTextureParam;
+	static const FName BumpTextureParam;
+	static const FName DetailTextureParam;
+	static const FName ReflectanceTextureParam;
+	static const FName DetailScaleParam;
+	static const FName ReflectanceParam;
+
+	FDtsMaterialImporter(UMaterialInterface* baseMaterial, const FString& textureSearchRoot);
+
+	// Returns one material per entry of shape.materials (nullptr for auxiliary bump/detail/reflectance-only entries).
+	// Assets are created next to the package at destinationPath.
+	TArray<UMaterialInterface*> importMaterials(const FDtsShape& shape, const FString& sourceFilename, const FString& destinationPath);
+
+private:
+	const FDtsTextureIndex& getIndex(const FString& sourceFilename);
+	UMaterialInterface* getBaseMaterial(const FString& destinationPath);
+	UTexture* importTexture(const FString& textureName, const FString& sourceFilename, const FString& destinationPath, bool clampX, bool clampY);
+	void setupMaterial(UMaterialInstanceConstant* instance, const FDtsShape& shape, const FDtsMaterial& material, const FString& sourceFilename, const FString& destinationPath);
+
+	UMaterialInterface* baseMaterial;
+	bool baseMaterialChecked = false;
+	FString textureSearchRoot;
+	TMap<FString, TUniquePtr<FDtsTextureIndex>> indices;	// root -> index
+	TMap<TTuple<FString, bool, bool>, UTexture*> textures;	// (source path, clamp X, clamp Y) -> imported texture
+	TMap<FString, FString> textureSources;					// texture package name -> source path imported into it
+	TMap<FString, UMaterialInterface*> materials;			// package name -> created material instance
+	TMap<FString, uint32> materialSignatures;				// material instance name -> signature of the first material that used it
+	TSet<FString> missingTextures;
+};
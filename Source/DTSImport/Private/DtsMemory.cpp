@@ -0,0 +1,111 @@
+
+
+#include "DtsMemory.h"
+#include "DtsShape.h"
+
+
+FDtsMemoryTracker::FDtsMemoryTracker()
+{
+	reset();
+}
+
+
+void FDtsMemoryTracker::raise(TAtomic<int64>& peakValue, int64 value)
+{
+	int64 previous = peakValue;
+	while (value > previous && !peakValue.CompareExchange(previous, value))
+	{
+	}
+}
+
+
+void FDtsMemoryTracker::add(EDtsMemoryStage stage, int64 bytes)
+{
+	raise(peak[int32(stage)], current[int32(stage)] += bytes);
+	raise(peakTotal, currentTotal += bytes);
+}
+
+
+void FDtsMemoryTracker::remove(EDtsMemoryStage stage, int64 bytes)
+{
+	current[int32(stage)] -= bytes;
+	currentTotal -= bytes;
+}
+
+
+void FDtsMemoryTracker::reset()
+{
+	for (auto i = 0; i < int32(EDtsMemoryStage::Num); i++)
+	{
+		current[i] = 0;
+		peak[i] = 0;
+	}
+	currentTotal = 0;
+	peakTotal = 0;
+}
+
+
+void FDtsMemoryTracker::resetPeaks()
+{
+	for (auto i = 0; i < int32(EDtsMemoryStage::Num); i++)
+	{
+		peak[i] = int64(current[i]);
+	}
+	peakTotal = int64(currentTotal);
+}
+
+
+FString FDtsMemoryTracker::describe() const
+{
+	auto format = [](int64 peakBytes, int64 finalBytes)
+	{
+		return FString::Printf(TEXT("%.2f/%.2f MB"), peakBytes / (1024.0 * 1024.0), finalBytes / (1024.0 * 1024.0));
+	};
+	return FString::Printf(TEXT("file buffer %s, parse %s, build %s, total %s (peak/final)"),
+		*format(peak[int32(EDtsMemoryStage::FileBuffer)], current[int32(EDtsMemoryStage::FileBuffer)]),
+		*format(peak[int32(EDtsMemoryStage::Parse)], current[int32(EDtsMemoryStage::Parse)]),
+		*format(peak[int32(EDtsMemoryStage::Build)], current[int32(EDtsMemoryStage::Build)]),
+		*format(peakTotal, currentTotal));
+}
+
+
+template<typename T>
+static int64 VectorBytes(const std::vector<T>& v)
+{
+	return int64(v.capacity()) * sizeof(T);
+}
+
+
+int64 DtsGetShapeBytes(const FDtsShape& shape)
+{
+	int64 bytes = sizeof(FDtsShape);
+	bytes += VectorBytes(shape.nodes) + VectorBytes(shape.objects) + VectorBytes(shape.iflMaterials) + VectorBytes(shape.details);
+	bytes += VectorBytes(shape.subShapeFirstNode) + VectorBytes(shape.subShapeFirstObject) + VectorBytes(shape.subShapeNumNodes) + VectorBytes(shape.subShapeNumObjects);
+	bytes += VectorBytes(shape.nodeRotations) + VectorBytes(shape.nodeTranslations) + VectorBytes(shape.nodeUniformScales) + VectorBytes(shape.nodeAlignedScales);
+	bytes += VectorBytes(shape.nodeArbScaleFactors) + VectorBytes(shape.nodeArbScaleRots) + VectorBytes(shape.objectStates);
+	bytes += VectorBytes(shape.groundTranslations) + VectorBytes(shape.groundRotations) + VectorBytes(shape.triggers);
+	bytes += VectorBytes(shape.names) + VectorBytes(shape.materials) + VectorBytes(shape.meshes) + VectorBytes(shape.sequences);
+	for (const std::string& name : shape.names)
+	{
+		bytes += name.capacity();
+	}
+	for (const FDtsMaterial& material : shape.materials)
+	{
+		bytes += material.name.capacity();
+	}
+	for (const FDtsMesh& mesh : shape.meshes)
+	{
+		bytes += VectorBytes(mesh.verts) + VectorBytes(mesh.tverts) + VectorBytes(mesh.tverts2) + VectorBytes(mesh.colors);
+		bytes += VectorBytes(mesh.norms) + VectorBytes(mesh.encodedNorms) + VectorBytes(mesh.primitives) + VectorBytes(mesh.indices);
+		bytes += VectorBytes(mesh.clusters) + VectorBytes(mesh.startClusters) + VectorBytes(mesh.firstVerts) + VectorBytes(mesh.clusterNumVerts) + VectorBytes(mesh.firstTVerts);
+		const FDtsSkin& skin = mesh.skin;
+		bytes += VectorBytes(skin.initialVerts) + VectorBytes(skin.initialNorms) + VectorBytes(skin.initialEncodedNorms) + VectorBytes(skin.initialTransforms);
+		bytes += VectorBytes(skin.vertIndices) + VectorBytes(skin.boneIndices) + VectorBytes(skin.weights) + VectorBytes(skin.nodeIndices);
+	}
+	for (const FDtsSequence& sequence : shape.sequences)
+	{
+		bytes += VectorBytes(sequence.rotationMatters) + VectorBytes(sequence.translationMatters) + VectorBytes(sequence.scaleMatters) + VectorBytes(sequence.decalMatters);
+		bytes += VectorBytes(sequence.iflMatters) + VectorBytes(sequence.visMatters) + VectorBytes(sequence.frameMatters) + VectorBytes(sequence.matFrameMatters);
+	}
+	return bytes;
+}
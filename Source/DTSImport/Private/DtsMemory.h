@@ -0,0 +1,76 @@
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Templates/Atomic.h"
+
+struct FDtsShape;
+
+
+enum class EDtsMemoryStage : uint8
+{
+	FileBuffer,								// Whole-file buffers and streaming windows
+	Parse,									// Decoded shapes
+	Build,									// Triangulation cache and imposter atlas while building, then built assets until the batch ends
+	Num,
+};
+
+
+// Bytes held by an import batch per stage, with peaks. Thread safe: sequence files are decoded on worker threads.
+class FDtsMemoryTracker
+{
+public:
+	FDtsMemoryTracker();
+
+	void add(EDtsMemoryStage stage, int64 bytes);
+	void remove(EDtsMemoryStage stage, int64 bytes);
+	void reset();
+
+	// Peaks restart from the current values, so each import reports its own
+	void resetPeaks();
+
+	int64 getCurrent(EDtsMemoryStage stage) const { return current[int32(stage)]; }
+	int64 getPeak(EDtsMemoryStage stage) const { return peak[int32(stage)]; }
+	int64 getCurrentTotal() const { return currentTotal; }
+	int64 getPeakTotal() const { return peakTotal; }
+
+	// "peak/final" bytes of each stage and of the total
+	FString describe() const;
+
+private:
+	static void raise(TAtomic<int64>& peakValue, int64 value);
+
+	TAtomic<int64> current[int32(EDtsMemoryStage::Num)];
+	TAtomic<int64> peak[int32(EDtsMemoryStage::Num)];
+	TAtomic<int64> currentTotal;
+	TAtomic<int64> peakTotal;
+};
+
+
+// Accounts bytes to a stage for the lifetime of the scope
+class FDtsMemoryScope
+{
+public:
+	FDtsMemoryScope(FDtsMemoryTracker& inTracker, EDtsMemoryStage inStage, int64 inBytes)
+		: tracker(inTracker)
+		, stage(inStage)
+		, bytes(inBytes)
+	{
+		tracker.add(stage, bytes);
+	}
+
+	~FDtsMemoryScope()
+	{
+		tracker.remove(stage, bytes);
+	}
+
+private:
+	FDtsMemoryTracker& tracker;
+	EDtsMemoryStage stage;
+	int64 bytes;
+};
+
+
+// Bytes allocated by the decoded arrays of a shape
+int64 DtsGetShapeBytes(const FDtsShape& shape);
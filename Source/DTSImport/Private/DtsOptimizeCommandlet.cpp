@@ -0,0 +1,107 @@
+
+
+#include "DtsOptimizeCommandlet.h"
+#include "DtsWriter.h"
+#include "DtsShape.h"
+#include "DtsFactory.h"
+
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+
+UDtsOptimizeCommandlet::UDtsOptimizeCommandlet(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+
+int32 UDtsOptimizeCommandlet::Main(const FString& Params)
+{
+	TArray<FString> Tokens;
+	TArray<FString> Switches;
+	TMap<FString, FString> ParamsMap;
+	ParseCommandLine(*Params, Tokens, Switches, ParamsMap);
+
+	const FString* In = ParamsMap.Find(TEXT("In"));
+	const FString* Out = ParamsMap.Find(TEXT("Out"));
+	if (!In || !Out)
+	{
+		UE_LOG(LogDts, Error, TEXT("Usage: -run=DtsOptimize -In=<file.dts|folder> -Out=<folder> [-Verify]"));
+		return 1;
+	}
+	const bool bVerify = Switches.Contains(TEXT("Verify"));
+
+	TArray<FString> Files;
+	if (IFileManager::Get().DirectoryExists(**In))
+	{
+		IFileManager::Get().FindFilesRecursive(Files, **In, TEXT("*.dts"), true, false);
+	}
+	else
+	{
+		Files.Add(*In);
+	}
+	IFileManager::Get().MakeDirectory(**Out, true);
+
+	UDtsFactory* Factory = NewObject<UDtsFactory>();
+	int32 NumFailed = 0;
+	int64 TotalIn = 0;
+	int64 TotalOut = 0;
+	double WriteSeconds = 0.0;
+	FDtsOptimizeStats Stats;
+	for (const FString& File : Files)
+	{
+		FDtsShape Original;
+		if (!Factory->readShapeFile(Original, File))
+		{
+			NumFailed++;
+			continue;
+		}
+		FDtsShape Shape = Original;
+		DtsOptimizeShape(Shape, Stats);
+
+		const double StartTime = FPlatformTime::Seconds();
+		TArray<uint8> Buffer;
+		const int64 Size = DtsWriteShape(Shape, Buffer);
+		const FString OutFile = FPaths::Combine(*Out, FPaths::GetCleanFilename(File));
+		if (!FFileHelper::SaveArrayToFile(Buffer, *OutFile))
+		{
+			UE_LOG(LogDts, Error, TEXT("Can't write file [%s]"), *OutFile);
+			NumFailed++;
+			continue;
+		}
+		WriteSeconds += FPlatformTime::Seconds() - StartTime;
+		const int64 InSize = IFileManager::Get().FileSize(*File);
+		TotalIn += InSize;
+		TotalOut += Size;
+		UE_LOG(LogDts, Verbose, TEXT("[%s] %li -> %li bytes"), *File, InSize, Size);
+
+		// The written file must parse back to itself, and to the same content as the input
+		if (bVerify)
+		{
+			FDtsShape Reparsed;
+			TArray<uint8> Rewritten;
+			FString Difference;
+			if (!Factory->parseDtsData(Reparsed, Buffer.GetData(), Buffer.Num()) || DtsWriteShape(Reparsed, Rewritten) != Size
+				|| FMemory::Memcmp(Rewritten.GetData(), Buffer.GetData(), Size) != 0)
+			{
+				UE_LOG(LogDts, Error, TEXT("Round trip of [%s] doesn't match"), *OutFile);
+				NumFailed++;
+			}
+			else if (!DtsCompareOptimizedShape(Original, Reparsed, Difference))
+			{
+				UE_LOG(LogDts, Error, TEXT("[%s] differs from [%s]: %s"), *OutFile, *File, *Difference);
+				NumFailed++;
+			}
+		}
+	}
+
+	UE_LOG(LogDts, Display, TEXT("Optimized %d files (%d failed): %li -> %li bytes, %d decal meshes, %d names and %d keys dropped, written at %.1f MB/s -> [%s]"),
+		Files.Num(), NumFailed, TotalIn, TotalOut, Stats.numDecalMeshes, Stats.numNamesDropped, Stats.numKeysDropped,
+		WriteSeconds > 0.0 ? TotalOut / (1024.0 * 1024.0) / WriteSeconds : 0.0, **Out);
+	return NumFailed > 0 ? 1 : 0;
+}
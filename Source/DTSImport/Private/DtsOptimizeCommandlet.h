@@ -0,0 +1,21 @@
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "DtsOptimizeCommandlet.generated.h"
+
+
+// Re-encodes DTS files without decals, unreferenced names and unreferenced keyframes.
+// Usage: -run=DtsOptimize -In=<file.dts|folder> -Out=<folder> [-Verify]
+// -Verify parses each written file again, writes it once more and checks both encodings are identical.
+UCLASS()
+class UDtsOptimizeCommandlet : public UCommandlet
+{
+	GENERATED_UCLASS_BODY()
+
+	//~ Begin UCommandlet Interface
+	int32 Main(const FString& Params) override;
+	//~ End UCommandlet Interface
+};
@@ -0,0 +1,66 @@
+
+
+#include "DtsQuantize.h"
+#include "DtsShape.h"
+
+#include "Math/Float16.h"
+#include "PackedNormal.h"
+
+
+static float GetUVError(const std::vector<FVector2D>& tverts)
+{
+	float maxError = 0.0f;
+	for (const FVector2D& uv : tverts)
+	{
+		const FFloat16 u(uv.X);
+		const FFloat16 v(uv.Y);
+		maxError = FMath::Max(maxError, FMath::Max(FMath::Abs(u.GetFloat() - uv.X), FMath::Abs(v.GetFloat() - uv.Y)));
+	}
+	return maxError;
+}
+
+
+static float GetNormalErrorDegrees(const std::vector<FVector>& norms)
+{
+	float minCos = 1.0f;
+	for (const FVector& norm : norms)
+	{
+		const FVector normal = norm.GetSafeNormal();
+		if (normal.IsZero())
+		{
+			continue;
+		}
+		const FVector packed = FPackedNormal(normal).ToFVector().GetSafeNormal();
+		minCos = FMath::Min(minCos, FVector::DotProduct(normal, packed));
+	}
+	return FMath::RadiansToDegrees(FMath::Acos(FMath::Clamp(minCos, -1.0f, 1.0f)));
+}
+
+
+void DtsQuantizeShape(FDtsShape& shape, const FDtsQuantizeSettings& settings, TArray<FDtsQuantizeReport>& reports)
+{
+	for (auto i = 0; i < int32(shape.meshes.size()); i++)
+	{
+		FDtsMesh& mesh = shape.meshes[i];
+		if (mesh.meshType == NullMeshType || mesh.meshType == DecalMeshType || mesh.vertexSource >= 0 || mesh.verts.empty())
+		{
+			continue;
+		}
+
+		FDtsQuantizeReport report;
+		report.meshIndex = i;
+		report.numVerts = mesh.verts.size();
+		report.maxUVError = GetUVError(mesh.tverts);
+		report.maxNormalErrorDegrees = GetNormalErrorDegrees(mesh.norms);
+		report.halfUVs = report.maxUVError <= settings.uvErrorBudget;
+		report.packedNormals = report.maxNormalErrorDegrees <= settings.normalErrorBudgetDegrees;
+		mesh.fullPrecisionUVs = !report.halfUVs;
+		mesh.highPrecisionNormals = !report.packedNormals;
+
+		// Per vertex: UV 4 or 8 bytes, tangent + normal 8 or 16 bytes
+		const int64 numUVs = mesh.tverts.size();
+		report.bytesDefault = numUVs * 4 + int64(report.numVerts) * 8;
+		report.bytesChosen = numUVs * (report.halfUVs ? 4 : 8) + int64(report.numVerts) * (report.packedNormals ? 8 : 16);
+		reports.Add(report);
+	}
+}
@@ -0,0 +1,34 @@
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FDtsShape;
+
+
+struct FDtsQuantizeSettings
+{
+	float uvErrorBudget = 1.0f / 1024.0f;		// UV units
+	float normalErrorBudgetDegrees = 2.0f;
+};
+
+
+// Result of checking one mesh's vertex data against the compact vertex formats
+struct FDtsQuantizeReport
+{
+	int32 meshIndex = -1;
+	int32 numVerts = 0;
+	float maxUVError = 0.0f;					// 16-bit float UVs
+	float maxNormalErrorDegrees = 0.0f;			// 8-bit packed normals. Tangents are built later and not checked, they pack with the same 8-bit components
+	bool halfUVs = false;
+	bool packedNormals = false;
+	int64 bytesDefault = 0;						// UV + tangent basis bytes in the engine's default formats (16-bit UVs, packed normals)
+	int64 bytesChosen = 0;						// The same with the formats chosen for the budgets, never less than bytesDefault
+};
+
+
+// Measures the error of the engine's default compact vertex formats for every mesh holding vertex data, and flags the
+// meshes that go over the budgets for full precision UVs / high precision normals (FDtsMesh::fullPrecisionUVs / highPrecisionNormals).
+// The engine defaults are already the compact formats, so this can only raise precision; the cost is bytesChosen - bytesDefault.
+void DtsQuantizeShape(FDtsShape& shape, const FDtsQuantizeSettings& settings, TArray<FDtsQuantizeReport>& reports);
@@ -0,0 +1,431 @@
+
+
+#include "DtsScan.h"
+#include "DtsShape.h"
+
+#include "HAL/PlatformFilemanager.h"
+#include "Async/ParallelFor.h"
+#include "Templates/UniquePtr.h"
+
+
+namespace
+{
+
+// Reads through a single small page so that consecutive fields cost one syscall,
+// while jumps over vertex/index arrays just move the offset without touching the file.
+class FDtsScanReader
+{
+public:
+	static constexpr int64 PageSize = 4096;
+
+	FDtsScanReader(IFileHandle* inHandle, int64 inFileSize)
+		: handle(inHandle)
+		, fileSize(inFileSize)
+	{
+	}
+
+	bool read(int64 offset, void* dest, int64 size)
+	{
+		if (offset < 0 || size < 0 || offset + size > fileSize)
+		{
+			return false;
+		}
+		if (offset < pageOffset || offset + size > pageOffset + pageSize)
+		{
+			if (size > PageSize)
+			{
+				return handle->Seek(offset) && handle->Read(static_cast<uint8*>(dest), size);
+			}
+			pageOffset = offset;
+			pageSize = FMath::Min(PageSize, fileSize - offset);
+			if (!handle->Seek(pageOffset) || !handle->Read(page, pageSize))
+			{
+				pageOffset = -1;
+				pageSize = 0;
+				return false;
+			}
+		}
+		FMemory::Memcpy(dest, page + (offset - pageOffset), size);
+		return true;
+	}
+
+private:
+	IFileHandle* handle;
+	int64 fileSize;
+	int64 pageOffset = -1;
+	int64 pageSize = 0;
+	uint8 page[PageSize];
+};
+
+
+// Sequential cursor over one region of the file.
+class FDtsScanCursor
+{
+public:
+	FDtsScanCursor(FDtsScanReader& inReader, int64 inOffset, int64 inEnd)
+		: reader(inReader)
+		, offset(inOffset)
+		, end(inEnd)
+	{
+	}
+
+	template<typename T>
+	bool get(T& out)
+	{
+		if (offset + int64(sizeof(T)) > end || !reader.read(offset, &out, sizeof(T)))
+		{
+			return false;
+		}
+		offset += sizeof(T);
+		return true;
+	}
+
+	bool skip(int64 count, int64 elementSize)
+	{
+		if (count < 0 || offset + count * elementSize > end)
+		{
+			return false;
+		}
+		offset += count * elementSize;
+		return true;
+	}
+
+	bool skip32(int64 count)
+	{
+		return skip(count, sizeof(uint32_t));
+	}
+
+	// Skips a counted 32-bit array of elementWords words per element
+	bool skipCounted32(int32_t elementWords, int32_t* countOut = nullptr)
+	{
+		int32_t count = 0;
+		if (!get(count) || !skip32(int64(count) * elementWords))
+		{
+			return false;
+		}
+		if (countOut)
+		{
+			*countOut = count;
+		}
+		return true;
+	}
+
+	bool guard(uint32_t& guardValue)
+	{
+		uint32_t value = 0;
+		if (!get(value) || value != guardValue)
+		{
+			return false;
+		}
+		guardValue++;
+		return true;
+	}
+
+private:
+	FDtsScanReader& reader;
+	int64 offset;
+	int64 end;
+};
+
+
+// Walks the 32-bit part of one mesh (same layout as UDtsFactory::parseMesh). The 16-bit and 8-bit parts are never read.
+bool ScanMesh(uint32_t version, FDtsScanCursor& mem32, uint32_t& guardValue, FDtsScanInfo& info)
+{
+	uint32_t meshType = 0;
+	if (!mem32.get(meshType))
+	{
+		return false;
+	}
+	if (meshType == NullMeshType)
+	{
+		return true;
+	}
+	if (!mem32.guard(guardValue))
+	{
+		return false;
+	}
+
+	int32_t parentMesh = -1;
+	int32_t numVerts = 0;
+	int32_t numPrimitives = 0;
+	int32_t numIndices = 0;
+	if (!mem32.skip32(2)						// numFrames, numMatFrames
+		|| !mem32.get(parentMesh)
+		|| !mem32.skip32(6 + 3 + 1))			// bounds, center, radius
+	{
+		return false;
+	}
+	// Vertex data of a mesh with a parent is only stored with the parent
+	const int32_t stored = parentMesh >= 0 ? 0 : 1;
+	if (!mem32.get(numVerts)
+		|| !mem32.skip32(int64(numVerts) * 3 * stored)		// verts
+		|| !mem32.skipCounted32(2 * stored))				// tverts
+	{
+		return false;
+	}
+	info.numVerts += numVerts;
+	if (version >= 26)
+	{
+		if (!mem32.skipCounted32(2 * stored) || !mem32.skipCounted32(stored))	// tverts2, colors
+		{
+			return false;
+		}
+	}
+	if (!mem32.skip32(int64(numVerts) * 3 * stored)	// normals
+		|| !mem32.get(numPrimitives)
+		|| !mem32.skip32(int64(numPrimitives) * (version <= 24 ? 1 : 3))
+		|| !mem32.get(numIndices)
+		|| !mem32.skip32(version <= 25 ? 0 : numIndices)
+		|| !mem32.skip32(1 + 1 + 1)				// numMergeIndices (16-bit data), vertsPerFrame, flags
+		|| !mem32.guard(guardValue))
+	{
+		return false;
+	}
+
+	if (meshType == SkinMeshType)
+	{
+		int32_t numInitialVerts = 0;
+		if (!mem32.get(numInitialVerts)
+			|| !mem32.skip32(int64(numInitialVerts) * (3 + 3) * stored)	// initial verts, normals
+			|| !mem32.skipCounted32(16 * stored)						// initial transforms
+			|| !mem32.skipCounted32(stored)								// vertex indices
+			|| !mem32.skipCounted32(stored)								// bone indices
+			|| !mem32.skipCounted32(stored)								// weights
+			|| !mem32.skipCounted32(stored)								// node indices
+			|| !mem32.guard(guardValue))
+		{
+			return false;
+		}
+	}
+	else if (meshType == SortedMeshType)
+	{
+		if (!mem32.skipCounted32(8)		// clusters
+			|| !mem32.skipCounted32(1)	// start clusters
+			|| !mem32.skipCounted32(1)	// first verts
+			|| !mem32.skipCounted32(1)	// num verts
+			|| !mem32.skipCounted32(1)	// first tverts
+			|| !mem32.skip32(1)			// alwaysWriteDepth
+			|| !mem32.guard(guardValue))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+bool ScanMembuffer32(uint32_t version, FDtsScanCursor& mem32, FDtsScanInfo& info)
+{
+	int32_t counts[17] = {};
+	for (auto i = 0; i < 17; i++)
+	{
+		if (!mem32.get(counts[i]))
+		{
+			return false;
+		}
+	}
+	int32_t numNodes = counts[0];
+	int32_t numObjects = counts[1];
+	int32_t numDecals = counts[2];
+	int32_t numSubShapes = counts[3];
+	int32_t numIFLs = counts[4];
+	int32_t numNodeTranslations = counts[6];
+	int32_t numNodeUniformScales = counts[7];
+	int32_t numNodeAlignedScales = counts[8];
+	int32_t numNodeArbScales = counts[9];
+	int32_t numGroundFrames = counts[10];
+	int32_t numObjectStates = counts[11];
+	int32_t numDecalStates = counts[12];
+	int32_t numTriggers = counts[13];
+	int32_t numDetails = counts[14];
+	int32_t numMeshes = counts[15];
+	int32_t numNames = counts[16];
+
+	info.numNodes = numNodes;
+	info.numObjects = numObjects;
+	info.numDetails = numDetails;
+	info.numMeshes = numMeshes;
+	info.numNames = numNames;
+
+	// Everything between the count block and the meshes has a size derived from the counts above.
+	uint32_t guardValue = 0;
+	bool ok = mem32.skip32(2)											// smallestVisibleSize, smallestVisibleDL
+		&& mem32.guard(guardValue)
+		&& mem32.skip32(2 + 3 + 6)										// radius, tubeRadius, center, bounds
+		&& mem32.guard(guardValue)
+		&& mem32.skip32(int64(numNodes) * 5)
+		&& mem32.guard(guardValue)
+		&& mem32.skip32(int64(numObjects) * 6)
+		&& mem32.guard(guardValue)
+		&& mem32.skip32(int64(numDecals) * 5)
+		&& mem32.guard(guardValue)
+		&& mem32.skip32(int64(numIFLs) * 5)
+		&& mem32.guard(guardValue)
+		&& mem32.skip32(int64(numSubShapes) * 3)
+		&& mem32.guard(guardValue)
+		&& mem32.skip32(int64(numSubShapes) * 3)
+		&& mem32.guard(guardValue)
+		&& mem32.skip32(int64(numNodes) * 3 + int64(numNodeTranslations) * 3)	// default and keyframe translations
+		&& mem32.guard(guardValue)
+		&& mem32.skip32(int64(numNodeUniformScales) + int64(numNodeAlignedScales) * 3 + int64(numNodeArbScales) * 3)
+		&& mem32.guard(guardValue)
+		&& mem32.skip32(int64(numGroundFrames) * 3)
+		&& mem32.guard(guardValue)
+		&& mem32.skip32(int64(numObjectStates) * 3)
+		&& mem32.guard(guardValue)
+		&& mem32.skip32(numDecalStates)
+		&& mem32.guard(guardValue)
+		&& mem32.skip32(int64(numTriggers) * 2)
+		&& mem32.guard(guardValue)
+		&& mem32.skip32(int64(numDetails) * (version >= 26 ? 13 : 7))
+		&& mem32.guard(guardValue);
+	if (!ok)
+	{
+		return false;
+	}
+
+	info.numVerts = 0;
+	for (auto i = 0; i < numMeshes; i++)
+	{
+		if (!ScanMesh(version, mem32, guardValue, info))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+bool ScanTail(FDtsScanCursor& tail, FDtsScanInfo& info)
+{
+	int32_t numSequences = 0;
+	if (!tail.get(numSequences) || numSequences < 0)
+	{
+		return false;
+	}
+	for (auto num = 0; num < numSequences; num++)
+	{
+		if (!tail.skip32(15))		// nameIndex .. toolBegin
+		{
+			return false;
+		}
+		for (auto bitset = 0; bitset < 8; bitset++)
+		{
+			if (!tail.skip32(1) || !tail.skipCounted32(1))
+			{
+				return false;
+			}
+		}
+	}
+	info.numSequences = numSequences;
+
+	int8_t matStreamType = 0;
+	if (!tail.get(matStreamType))
+	{
+		return false;
+	}
+	if (matStreamType == 1)
+	{
+		int32_t numMaterials = 0;
+		if (!tail.get(numMaterials))
+		{
+			return false;
+		}
+		info.numMaterials = numMaterials;
+	}
+	return true;
+}
+
+}
+
+
+bool DtsScanFile(const FString& filename, FDtsScanInfo& info)
+{
+	info = FDtsScanInfo();
+	info.filename = filename;
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	TUniquePtr<IFileHandle> fileHandle(PlatformFile.OpenRead(*filename));
+	if (!fileHandle)
+	{
+		return false;
+	}
+	info.fileSize = fileHandle->Size();
+
+	FDtsScanReader reader(fileHandle.Get(), info.fileSize);
+	uint32_t header[4] = {};
+	if (!reader.read(0, header, sizeof(header)))
+	{
+		return false;
+	}
+	info.version = header[0] & 0xFFFF;
+	info.exporterVersion = header[0] >> 16;
+	if (info.version < 19)
+	{
+		return false;
+	}
+
+	uint32_t sizeMemBuffer = header[1];
+	uint32_t startU16 = header[2];
+	const int64 memBufferOffset = sizeof(header);
+	const int64 tailOffset = memBufferOffset + int64(sizeMemBuffer) * 4;
+	if (startU16 > sizeMemBuffer || tailOffset > info.fileSize)
+	{
+		return false;
+	}
+
+	FDtsScanCursor mem32(reader, memBufferOffset, memBufferOffset + int64(startU16) * 4);
+	if (!ScanMembuffer32(info.version, mem32, info))
+	{
+		return false;
+	}
+
+	FDtsScanCursor tail(reader, tailOffset, info.fileSize);
+	if (!ScanTail(tail, info))
+	{
+		return false;
+	}
+
+	info.valid = true;
+	return true;
+}
+
+
+void DtsScanFiles(const TArray<FString>& filenames, TArray<FDtsScanInfo>& infos)
+{
+	infos.SetNum(filenames.Num());
+	ParallelFor(filenames.Num(), [&filenames, &infos](int32 index)
+	{
+		DtsScanFile(filenames[index], infos[index]);
+	});
+}
+
+
+FString DtsScanToCsv(const TArray<FDtsScanInfo>& infos)
+{
+	FString out = TEXT("file,size,valid,version,exporterVersion,nodes,objects,meshes,verts,sequences,materials,details,names\n");
+	for (const FDtsScanInfo& info : infos)
+	{
+		out += FString::Printf(TEXT("\"%s\",%lld,%d,%u,%u,%d,%d,%d,%lld,%d,%d,%d,%d\n"),
+			*info.filename.Replace(TEXT("\""), TEXT("\"\"")), info.fileSize, info.valid ? 1 : 0, info.version, info.exporterVersion,
+			info.numNodes, info.numObjects, info.numMeshes, info.numVerts, info.numSequences, info.numMaterials, info.numDetails, info.numNames);
+	}
+	return out;
+}
+
+
+FString DtsScanToJson(const TArray<FDtsScanInfo>& infos)
+{
+	FString out = TEXT("[\n");
+	for (auto i = 0; i < infos.Num(); i++)
+	{
+		const FDtsScanInfo& info = infos[i];
+		FString escaped = info.filename.Replace(TEXT("\\"), TEXT("\\\\")).Replace(TEXT("\""), TEXT("\\\""));
+		out += FString::Printf(TEXT("  {\"file\": \"%s\", \"size\": %lld, \"valid\": %s, \"version\": %u, \"exporterVersion\": %u, \"nodes\": %d, \"objects\": %d, \"meshes\": %d, \"verts\": %lld, \"sequences\": %d, \"materials\": %d, \"details\": %d, \"names\": %d}%s\n"),
+			*escaped, info.fileSize, info.valid ? TEXT("true") : TEXT("false"), info.version, info.exporterVersion,
+			info.numNodes, info.numObjects, info.numMeshes, info.numVerts, info.numSequences, info.numMaterials, info.numDetails, info.numNames,
+			i + 1 < infos.Num() ? TEXT(",") : TEXT(""));
+	}
+	out += TEXT("]\n");
+	return out;
+}
@@ -0,0 +1,36 @@
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+// Summary of a DTS file gathered without decoding the membuffer bulk.
+// Only the header, the count block at the top of the 32-bit membuffer, the 32-bit mesh headers
+// and the sequence/material tail are read; vertex, index and keyframe arrays are seeked over.
+struct FDtsScanInfo
+{
+	FString filename;
+	int64 fileSize = 0;
+	bool valid = false;
+	uint32_t version = 0;			// DTS version (low 16 bits of the first word)
+	uint32_t exporterVersion = 0;	// Exporter version (high 16 bits of the first word)
+	int32_t numNodes = 0;
+	int32_t numObjects = 0;
+	int32_t numSequences = 0;
+	int32_t numMaterials = 0;
+	int32_t numDetails = 0;
+	int32_t numMeshes = 0;
+	int32_t numNames = 0;
+	int64 numVerts = 0;				// Sum of numVerts over all non-null meshes (all detail levels and keyframes)
+};
+
+
+// Scans a single file. Returns false (and info.valid == false) if the file can't be read or its layout doesn't add up.
+bool DtsScanFile(const FString& filename, FDtsScanInfo& info);
+
+// Scans files on worker threads. infos is resized to match filenames.
+void DtsScanFiles(const TArray<FString>& filenames, TArray<FDtsScanInfo>& infos);
+
+FString DtsScanToCsv(const TArray<FDtsScanInfo>& infos);
+FString DtsScanToJson(const TArray<FDtsScanInfo>& infos);
@@ -0,0 +1,66 @@
+
+
+#include "DtsScanCommandlet.h"
+#include "DtsScan.h"
+#include "DtsFactory.h"
+
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+
+UDtsScanCommandlet::UDtsScanCommandlet(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+
+int32 UDtsScanCommandlet::Main(const FString& Params)
+{
+	TArray<FString> Tokens;
+	TArray<FString> Switches;
+	TMap<FString, FString> ParamsMap;
+	ParseCommandLine(*Params, Tokens, Switches, ParamsMap);
+
+	const FString* Dir = ParamsMap.Find(TEXT("Dir"));
+	const FString* Out = ParamsMap.Find(TEXT("Out"));
+	if (!Dir || !Out)
+	{
+		UE_LOG(LogDts, Error, TEXT("Usage: -run=DtsScan -Dir=<folder> -Out=<file.csv|file.json> [-Json]"));
+		return 1;
+	}
+	const bool bJson = Switches.Contains(TEXT("Json")) || FPaths::GetExtension(*Out) == TEXT("json");
+
+	TArray<FString> Files;
+	IFileManager::Get().FindFilesRecursive(Files, **Dir, TEXT("*.dts"), true, false);
+
+	const double StartTime = FPlatformTime::Seconds();
+	TArray<FDtsScanInfo> Infos;
+	DtsScanFiles(Files, Infos);
+	const double Elapsed = FPlatformTime::Seconds() - StartTime;
+
+	int32 NumInvalid = 0;
+	for (const FDtsScanInfo& Info : Infos)
+	{
+		if (!Info.valid)
+		{
+			UE_LOG(LogDts, Warning, TEXT("Can't scan file [%s]"), *Info.filename);
+			NumInvalid++;
+		}
+	}
+
+	const FString Index = bJson ? DtsScanToJson(Infos) : DtsScanToCsv(Infos);
+	if (!FFileHelper::SaveStringToFile(Index, **Out))
+	{
+		UE_LOG(LogDts, Error, TEXT("Can't write index [%s]"), **Out);
+		return 1;
+	}
+
+	UE_LOG(LogDts, Display, TEXT("Scanned %d files (%d invalid) in %.3f s (%.0f files/s) -> [%s]"),
+		Files.Num(), NumInvalid, Elapsed, Elapsed > 0.0 ? Files.Num() / Elapsed : 0.0, **Out);
+	return 0;
+}
@@ -0,0 +1,20 @@
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "DtsScanCommandlet.generated.h"
+
+
+// Writes a CSV or JSON index of DTS files without importing them.
+// Usage: -run=DtsScan -Dir=<folder> -Out=<file.csv|file.json> [-Json]
+UCLASS()
+class UDtsScanCommandlet : public UCommandlet
+{
+	GENERATED_UCLASS_BODY()
+
+	//~ Begin UCommandlet Interface
+	int32 Main(const FString& Params) override;
+	//~ End UCommandlet Interface
+};
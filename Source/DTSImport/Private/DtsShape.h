@@ -0,0 +1,337 @@
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include <string>
+#include <vector>
+
+
+// Decoded DTS shape. Arrays keep the file's layout (one std::vector per field) so indices stored in the file
+// (startMeshIndex, nameIndex, matIndex ...) can be used as is.
+
+
+enum DTSMeshType : uint32_t
+{
+	StandardMeshType = 0,
+	SkinMeshType = 1,
+	DecalMeshType = 2,
+	SortedMeshType = 3,
+	NullMeshType = 4,
+	// flags stored with meshType:
+	//UseEncodedNormals = BIT(28),
+	//BillboardZAxis = BIT(29),
+	//HasDetailTexture = BIT(30),
+	//Billboard = BIT(31),
+};
+
+
+// Primitive::matIndex flags
+enum DTSPrimitiveFlags : uint32_t
+{
+	PrimitiveTriangles = 0x00000000,
+	PrimitiveStrip = 0x40000000,
+	PrimitiveFan = 0x80000000,
+	PrimitiveTypeMask = 0xC0000000,
+	PrimitiveIndexed = 0x20000000,
+	PrimitiveNoMaterial = 0x10000000,
+	PrimitiveMaterialMask = 0x0FFFFFFF,
+};
+
+
+// Material flags
+enum DTSMaterialFlags : uint32_t
+{
+	MaterialSWrap = 0x00000001,
+	MaterialTWrap = 0x00000002,
+	MaterialTranslucent = 0x00000004,
+	MaterialAdditive = 0x00000008,
+	MaterialSubtractive = 0x00000010,
+	MaterialSelfIlluminating = 0x00000020,
+	MaterialNeverEnvMap = 0x00000040,
+	MaterialNoMipMap = 0x00000080,
+	MaterialMipMapZeroBorder = 0x00000100,
+	MaterialIflMaterial = 0x08000000,
+	MaterialIflFrame = 0x10000000,
+	MaterialDetailMapOnly = 0x20000000,
+	MaterialBumpMapOnly = 0x40000000,
+	MaterialReflectanceMapOnly = 0x80000000,
+	MaterialAuxiliaryMap = MaterialDetailMapOnly | MaterialBumpMapOnly | MaterialReflectanceMapOnly,
+};
+
+
+// Sequence flags
+enum DTSSequenceFlags : uint32_t
+{
+	SequenceUniformScale = 0x0001,
+	SequenceAlignedScale = 0x0002,
+	SequenceArbitraryScale = 0x0004,
+	SequenceBlend = 0x0008,
+	SequenceCyclic = 0x0010,
+	SequenceMakePath = 0x0020,
+	SequenceIflInit = 0x0040,
+	SequenceHasTranslucency = 0x0080,
+};
+
+
+// Trigger::state flags
+enum DTSTriggerFlags : uint32_t
+{
+	TriggerStateOn = 0x80000000,
+	TriggerInvertOnReverse = 0x40000000,
+	TriggerStateMask = 0x3FFFFFFF,			// One bit, 1 << (trigger number - 1)
+};
+
+
+struct FDtsNode
+{
+	int32_t nameIndex = -1;
+	int32_t parentIndex = -1;
+	int32_t firstObject = -1;
+	int32_t firstChild = -1;
+	int32_t nextSibling = -1;
+	FQuat defaultRotation = FQuat::Identity;
+	FVector defaultTranslation = FVector::ZeroVector;
+};
+
+
+struct FDtsObject
+{
+	int32_t nameIndex = -1;
+	int32_t numMeshes = 0;
+	int32_t startMeshIndex = 0;
+	int32_t nodeIndex = -1;
+	int32_t nextSibling = -1;
+	int32_t firstDecal = -1;
+};
+
+
+struct FDtsDetail
+{
+	int32_t nameIndex = -1;
+	int32_t subShapeNum = 0;
+	int32_t objectDetailNum = 0;
+	float size = 0.0f;
+	float averageError = 0.0f;
+	float maxError = 0.0f;
+	int32_t polyCount = 0;
+	float alphaIn = 0.0f;
+	float alphaOut = 0.0f;
+
+	// Billboard (imposter) settings, DTS v26+
+	int32_t bbDimension = 0;
+	int32_t bbDetailLevel = 0;
+	uint32_t bbEquatorSteps = 0;
+	uint32_t bbPolarSteps = 0;
+	float bbPolarAngle = 0.0f;
+	uint32_t bbIncludePoles = 0;
+};
+
+
+struct FDtsIflMaterial
+{
+	int32_t nameIndex = -1;
+	int32_t materialSlot = 0;
+	int32_t firstFrame = 0;
+	int32_t firstFrameOffTimeIndex = 0;
+	int32_t numFrames = 0;
+};
+
+
+struct FDtsObjectState
+{
+	float vis = 1.0f;
+	int32_t frameIndex = 0;
+	int32_t matFrame = 0;
+};
+
+
+struct FDtsPrimitive
+{
+	int32_t start = 0;
+	int32_t numElements = 0;
+	uint32_t matIndex = 0;
+};
+
+
+// Skin data. Counts are kept as stored; the arrays are empty when the mesh uses its parent's data
+struct FDtsSkin
+{
+	int32_t numInitialVerts = 0;
+	int32_t numInitialTransforms = 0;
+	int32_t numVertIndices = 0;
+	int32_t numBoneIndices = 0;
+	int32_t numWeights = 0;
+	int32_t numNodeIndices = 0;
+	std::vector<FVector> initialVerts;
+	std::vector<FVector> initialNorms;
+	std::vector<uint8_t> initialEncodedNorms;
+	std::vector<FMatrix> initialTransforms;
+	std::vector<int32_t> vertIndices;
+	std::vector<int32_t> boneIndices;
+	std::vector<float> weights;
+	std::vector<int32_t> nodeIndices;
+};
+
+
+// Sorted mesh cluster. Drawing starts at a start cluster and continues with frontCluster if dot(normal, camera) > k, else backCluster, until -1
+struct FDtsCluster
+{
+	int32_t startPrimitive = 0;
+	int32_t endPrimitive = 0;				// Exclusive
+	FVector normal = FVector::ZeroVector;
+	float k = 0.0f;
+	int32_t frontCluster = -1;
+	int32_t backCluster = -1;
+};
+
+
+struct FDtsMesh
+{
+	uint32_t meshType = NullMeshType;
+	int32_t numFrames = 0;
+	int32_t numMatFrames = 0;
+	int32_t parentMesh = -1;
+	FBox bounds = FBox(ForceInit);
+	FVector center = FVector::ZeroVector;
+	float radius = 0.0f;
+	int32_t numVerts = 0;					// As stored in the file; verts may be empty if the data lives in vertexSource
+	std::vector<FVector> verts;				// numFrames * vertsPerFrame positions
+	std::vector<FVector2D> tverts;			// numMatFrames * vertsPerFrame UVs
+	int32_t numTVerts = 0;					// As stored in the file
+	std::vector<FVector2D> tverts2;			// DTS v26+
+	int32_t numTVerts2 = 0;
+	std::vector<uint32_t> colors;			// DTS v26+, RGBA bytes
+	int32_t numColors = 0;
+	std::vector<FVector> norms;
+	std::vector<uint8_t> encodedNorms;
+	std::vector<FDtsPrimitive> primitives;
+	std::vector<int32_t> indices;
+	int32_t vertsPerFrame = 0;
+	uint32_t flags = 0;
+	FDtsSkin skin;							// SkinMeshType only
+
+	// SortedMeshType only
+	std::vector<FDtsCluster> clusters;
+	std::vector<int32_t> startClusters;		// Per frame
+	std::vector<int32_t> firstVerts;		// Per frame
+	std::vector<int32_t> clusterNumVerts;	// Per frame
+	std::vector<int32_t> firstTVerts;		// Per frame
+	bool alwaysWriteDepth = false;
+
+	int32_t vertexSource = -1;				// Mesh holding verts/tverts/norms when they are shared (parentMesh or identical content), -1 if this mesh holds its own
+	int32_t instanceOf = -1;				// First mesh with identical vertex data, primitives and indices, -1 if none
+
+	// Set by DtsQuantizeShape when the engine's default compact formats go over the import error budgets.
+	// highPrecisionNormals also raises tangents, which are not checked themselves
+	bool fullPrecisionUVs = false;
+	bool highPrecisionNormals = false;
+};
+
+
+struct FDtsSequence
+{
+	int32_t nameIndex = -1;
+	uint32_t flags = 0;
+	int32_t numKeyframes = 0;
+	float duration = 0.0f;					// Seconds
+	int32_t priority = 0;
+	int32_t firstGroundFrame = 0;			// Index into groundTranslations/groundRotations
+	int32_t numGroundFrames = 0;
+	int32_t baseRotation = 0;
+	int32_t baseTranslation = 0;
+	int32_t baseScale = 0;
+	int32_t baseObjectState = 0;
+	int32_t baseDecalState = 0;
+	int32_t firstTrigger = 0;				// Index into triggers
+	int32_t numTriggers = 0;
+	float toolBegin = 0.0f;
+	std::vector<uint32_t> rotationMatters;	// Bitsets over nodes, objects or meshes
+	std::vector<uint32_t> translationMatters;
+	std::vector<uint32_t> scaleMatters;
+	std::vector<uint32_t> decalMatters;
+	std::vector<uint32_t> iflMatters;
+	std::vector<uint32_t> visMatters;
+	std::vector<uint32_t> frameMatters;
+	std::vector<uint32_t> matFrameMatters;
+};
+
+
+struct FDtsTrigger
+{
+	uint32_t state = 0;
+	float pos = 0.0f;						// Normalized position in the sequence, 0-1
+};
+
+
+// What mesh deduplication saved for one shape
+struct FDtsDedupStats
+{
+	int32 numParentShared = 0;				// Meshes reusing their parentMesh's vertex data
+	int32 numContentShared = 0;				// Meshes whose vertex data matched an earlier mesh byte for byte
+	int32 numInstances = 0;					// Meshes identical to an earlier mesh (vertex data, primitives and indices)
+	int32 numReusedLods = 0;				// Detail levels identical to the previous one
+	int64 bytesSaved = 0;					// Decoded vertex data not held thanks to sharing
+	double buildSecondsSaved = 0.0;			// Measured conversion time of instanced meshes, counted once per reuse
+};
+
+
+struct FDtsMaterial
+{
+	std::string name;
+	uint32_t flags = 0;
+	int32_t reflectanceMap = -1;
+	int32_t bumpMap = -1;
+	int32_t detailMap = -1;
+	float detailScale = 1.0f;
+	float reflectance = 0.0f;
+};
+
+
+struct FDtsShape
+{
+	uint32_t version = 0;
+	float radius = 0.0f;
+	float tubeRadius = 0.0f;
+	FVector center = FVector::ZeroVector;
+	FBox bounds = FBox(ForceInit);
+	float smallestVisibleSize = 0.0f;
+	int32_t smallestVisibleDL = 0;
+	std::vector<FDtsNode> nodes;
+	std::vector<FDtsObject> objects;
+	std::vector<FDtsIflMaterial> iflMaterials;
+	std::vector<int32_t> subShapeFirstNode;
+	std::vector<int32_t> subShapeFirstObject;
+	std::vector<int32_t> subShapeNumNodes;
+	std::vector<int32_t> subShapeNumObjects;
+	std::vector<FDtsDetail> details;
+	std::vector<FDtsMesh> meshes;
+	std::vector<std::string> names;
+	std::vector<FDtsMaterial> materials;
+	std::vector<FDtsSequence> sequences;
+	std::vector<FQuat> nodeRotations;		// Node keyframes of all sequences, numKeyframes per animated node
+	std::vector<FVector> nodeTranslations;
+	std::vector<float> nodeUniformScales;
+	std::vector<FVector> nodeAlignedScales;
+	std::vector<FVector> nodeArbScaleFactors;
+	std::vector<FQuat> nodeArbScaleRots;
+	std::vector<FDtsObjectState> objectStates;
+	std::vector<FVector> groundTranslations;	// Ground keyframes of all sequences
+	std::vector<FQuat> groundRotations;
+	std::vector<FDtsTrigger> triggers;		// Triggers of all sequences
+	FDtsDedupStats dedup;
+
+	// Mesh holding the vertex data used by meshes[meshIndex]
+	const FDtsMesh& getVertexData(int32_t meshIndex) const
+	{
+		const FDtsMesh& mesh = meshes[meshIndex];
+		return mesh.vertexSource >= 0 ? meshes[mesh.vertexSource] : mesh;
+	}
+
+	const std::string& getName(int32_t nameIndex) const
+	{
+		static const std::string empty;
+		return nameIndex >= 0 && nameIndex < int32_t(names.size()) ? names[nameIndex] : empty;
+	}
+};
@@ -0,0 +1,80 @@
+
+
+#include "DtsSortedMesh.h"
+#include "DtsShape.h"
+
+
+FDtsClusterTree::FDtsClusterTree(const FDtsMesh& mesh, int32 frame)
+{
+	numPrimitives = mesh.primitives.size();
+	const int32 numClusters = mesh.clusters.size();
+	if (numClusters == 0 || frame >= int32(mesh.startClusters.size()))
+	{
+		return;
+	}
+	const int32 startCluster = mesh.startClusters[frame];
+	if (startCluster < 0 || startCluster >= numClusters)
+	{
+		return;
+	}
+
+	// Breadth-first renumbering from the start cluster; unreachable clusters are dropped
+	TArray<int32> remap;
+	remap.Init(-1, numClusters);
+	TArray<int32> order;
+	order.Reserve(numClusters);
+	order.Add(startCluster);
+	remap[startCluster] = 0;
+	for (auto i = 0; i < order.Num(); i++)
+	{
+		const FDtsCluster& cluster = mesh.clusters[order[i]];
+		for (int32 child : { cluster.frontCluster, cluster.backCluster })
+		{
+			if (child >= 0 && child < numClusters && remap[child] < 0)
+			{
+				remap[child] = order.Num();
+				order.Add(child);
+			}
+		}
+	}
+
+	planes.SetNumUninitialized(order.Num());
+	children.SetNumUninitialized(order.Num());
+	primitives.SetNumUninitialized(order.Num());
+	for (auto i = 0; i < order.Num(); i++)
+	{
+		const FDtsCluster& cluster = mesh.clusters[order[i]];
+		planes[i] = FVector4(cluster.normal, cluster.k);
+		children[i] = FIntPoint(
+			cluster.frontCluster >= 0 && cluster.frontCluster < numClusters ? remap[cluster.frontCluster] : -1,
+			cluster.backCluster >= 0 && cluster.backCluster < numClusters ? remap[cluster.backCluster] : -1);
+		primitives[i] = FIntPoint(FMath::Clamp(cluster.startPrimitive, 0, numPrimitives), FMath::Clamp(cluster.endPrimitive, 0, numPrimitives));
+	}
+}
+
+
+void FDtsClusterTree::getPrimitiveOrder(const FVector& cameraPosition, TArray<int32>& primitiveOrder) const
+{
+	primitiveOrder.Reset();
+	// A walk visits each cluster at most once; the bound only protects against malformed cycles
+	int32 cluster = planes.Num() > 0 ? 0 : -1;
+	for (int32 steps = 0; cluster >= 0 && steps < planes.Num(); steps++)
+	{
+		const FIntPoint& range = primitives[cluster];
+		for (auto i = range.X; i < range.Y; i++)
+		{
+			primitiveOrder.Add(i);
+		}
+		const FVector4& plane = planes[cluster];
+		const float side = plane.X * cameraPosition.X + plane.Y * cameraPosition.Y + plane.Z * cameraPosition.Z;
+		cluster = side > plane.W ? children[cluster].X : children[cluster].Y;
+	}
+}
+
+
+void FDtsClusterTree::getOctantOrder(const FVector& center, float radius, int32 octant, TArray<int32>& primitiveOrder) const
+{
+	const float distance = FMath::Max(radius, 1.0f) * 10.0f;
+	const FVector direction((octant & 1) ? 1.0f : -1.0f, (octant & 2) ? 1.0f : -1.0f, (octant & 4) ? 1.0f : -1.0f);
+	getPrimitiveOrder(center + direction.GetUnsafeNormal() * distance, primitiveOrder);
+}
@@ -0,0 +1,32 @@
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FDtsMesh;
+
+
+// Flattened form of a sorted mesh's cluster graph.
+// The file stores clusters as an array of structs chained through frontCluster/backCluster indices, in exporter order.
+// Here clusters are renumbered in breadth-first order from the start cluster so a walk touches mostly increasing
+// addresses, and the data needed per step (plane, then children) is split into tightly packed arrays.
+class FDtsClusterTree
+{
+public:
+	FDtsClusterTree(const FDtsMesh& mesh, int32 frame = 0);
+
+	// Primitive indices in the order Torque draws them for a camera at cameraPosition (mesh space)
+	void getPrimitiveOrder(const FVector& cameraPosition, TArray<int32>& primitiveOrder) const;
+
+	// Primitive order when viewed from one of the 8 octants. Octant bits select the sign of the view direction in mesh space:
+	// bit 0 +X, bit 1 +Y, bit 2 +Z. The camera is placed outside the bounding sphere along that direction.
+	// Only the order for the factory's SortedMeshViewOctant is baked: a static mesh section has a single index order.
+	void getOctantOrder(const FVector& center, float radius, int32 octant, TArray<int32>& primitiveOrder) const;
+
+private:
+	TArray<FVector4> planes;		// normal, k
+	TArray<FIntPoint> children;		// front, back (flattened indices, -1 for none)
+	TArray<FIntPoint> primitives;	// startPrimitive, endPrimitive
+	int32 numPrimitives = 0;
+};
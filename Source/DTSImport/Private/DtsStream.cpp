@@ -0,0 +1,125 @@
+
+
+#include "DtsStream.h"
+
+#include "Async/Async.h"
+#include "HAL/PlatformFilemanager.h"
+
+
+FDtsStream::FDtsStream(const uint8* data, int64 size)
+	: pos(data)
+	, end(data + size)
+{
+}
+
+
+FDtsStream::FDtsStream(const FString& filename, int64 offset, int64 size, int64 windowSize)
+	: rangeEnd(offset + size)
+	, nextOffset(offset)
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	handle.Reset(PlatformFile.OpenRead(*filename));
+	if (!handle || offset + size > handle->Size())
+	{
+		valid = false;
+		return;
+	}
+	windowSize = FMath::Max<int64>(windowSize, 4096);
+	buffers[0].SetNumUninitialized(FMath::Min(windowSize, size));
+	buffers[1].SetNumUninitialized(FMath::Min(windowSize, size));
+	current = 1;
+	startRead();
+}
+
+
+FDtsStream::~FDtsStream()
+{
+	if (pending.IsValid())
+	{
+		pending.Wait();
+	}
+}
+
+
+// Reads the next window into the buffer that isn't being decoded
+void FDtsStream::startRead()
+{
+	const int32 index = current ^ 1;
+	pendingSize = FMath::Min<int64>(buffers[index].Num(), rangeEnd - nextOffset);
+	if (pendingSize <= 0)
+	{
+		pendingSize = 0;
+		return;
+	}
+	IFileHandle* fileHandle = handle.Get();
+	uint8* dest = buffers[index].GetData();
+	const int64 readOffset = nextOffset;
+	const int64 readSize = pendingSize;
+	nextOffset += pendingSize;
+	pending = Async(EAsyncExecution::ThreadPool, [fileHandle, dest, readOffset, readSize]()
+	{
+		return fileHandle->Seek(readOffset) && fileHandle->Read(dest, readSize);
+	});
+}
+
+
+// Switches to the window read in the background and immediately starts reading the one after it
+bool FDtsStream::nextWindow()
+{
+	if (!handle || !valid || !pending.IsValid())
+	{
+		return false;
+	}
+	if (!pending.Get())
+	{
+		valid = false;
+		return false;
+	}
+	pending = TFuture<bool>();
+	current ^= 1;
+	pos = buffers[current].GetData();
+	end = pos + pendingSize;
+	pendingSize = 0;
+	startRead();
+	return true;
+}
+
+
+bool FDtsStream::readSlow(uint8* dest, int64 size)
+{
+	while (size > 0)
+	{
+		if (pos == end && !nextWindow())
+		{
+			return false;
+		}
+		const int64 chunk = FMath::Min<int64>(size, end - pos);
+		FMemory::Memcpy(dest, pos, chunk);
+		pos += chunk;
+		dest += chunk;
+		size -= chunk;
+	}
+	return true;
+}
+
+
+bool FDtsStream::skip(int64 size)
+{
+	if (size < 0)
+	{
+		failed = true;
+		return false;
+	}
+	while (size > 0)
+	{
+		if (pos == end && !nextWindow())
+		{
+			failed = true;
+			return false;
+		}
+		const int64 chunk = FMath::Min<int64>(size, end - pos);
+		pos += chunk;
+		size -= chunk;
+	}
+	return true;
+}
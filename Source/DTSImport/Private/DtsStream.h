@@ -0,0 +1,66 @@
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "Templates/UniquePtr.h"
+
+class IFileHandle;
+
+
+// Sequential reader over one byte range of a DTS file (one of the 32/16/8-bit membuffer regions or the sequence/material tail).
+// Either wraps data that is already in memory, or streams the range from disk through two windowSize buffers:
+// while the parser decodes one buffer the next one is read on a worker thread, so peak memory per region is 2 * windowSize.
+class FDtsStream
+{
+public:
+	FDtsStream(const uint8* data, int64 size);
+	FDtsStream(const FString& filename, int64 offset, int64 size, int64 windowSize);
+	~FDtsStream();
+
+	FDtsStream(const FDtsStream&) = delete;
+	FDtsStream& operator=(const FDtsStream&) = delete;
+
+	bool isValid() const { return valid; }
+	bool hasFailed() const { return failed; }				// A read or skip went past the end, or the parser rejected the data
+	void fail() { failed = true; }
+	int64 remaining() const { return (end - pos) + (rangeEnd - nextOffset) + pendingSize; }
+
+	FORCEINLINE bool read(void* dest, int64 size)
+	{
+		if (size <= end - pos)
+		{
+			FMemory::Memcpy(dest, pos, size);
+			pos += size;
+			return true;
+		}
+		if (readSlow(static_cast<uint8*>(dest), size))
+		{
+			return true;
+		}
+		failed = true;
+		return false;
+	}
+
+	bool skip(int64 size);
+
+private:
+	bool readSlow(uint8* dest, int64 size);
+	bool nextWindow();
+	void startRead();
+
+	const uint8* pos = nullptr;
+	const uint8* end = nullptr;
+	bool valid = true;
+	bool failed = false;
+
+	// Streaming state, unused for memory-backed streams
+	TUniquePtr<IFileHandle> handle;
+	TArray<uint8> buffers[2];
+	int32 current = 0;
+	int64 rangeEnd = 0;
+	int64 nextOffset = 0;
+	int64 pendingSize = 0;
+	TFuture<bool> pending;
+};
@@ -0,0 +1,219 @@
+
+
+#include "DtsTangents.h"
+
+#include "Async/ParallelFor.h"
+
+
+namespace
+{
+
+constexpr int32 ChunkSize = 4096;
+
+
+struct FDtsCorner
+{
+	FVector faceNormal;			// Unit face normal
+	FVector sDir;				// Unit direction of increasing U across the face
+	FVector tDir;				// Unit direction of increasing V across the face
+	float angle;
+	bool mirrored;				// UVs wind clockwise
+};
+
+
+void ForEachChunk(int32 count, TFunctionRef<void(int32 begin, int32 end)> body)
+{
+	const int32 numChunks = (count + ChunkSize - 1) / ChunkSize;
+	ParallelFor(numChunks, [count, &body](int32 chunk)
+	{
+		body(chunk * ChunkSize, FMath::Min(count, (chunk + 1) * ChunkSize));
+	}, numChunks < 2);
+}
+
+
+FVector GetOrthogonal(const FVector& normal)
+{
+	const FVector axis = FMath::Abs(normal.X) < 0.9f ? FVector::ForwardVector : FVector::RightVector;
+	return FVector::CrossProduct(normal, axis).GetSafeNormal();
+}
+
+
+// Vertex -> corner lists in one flat array (CSR)
+struct FDtsAdjacency
+{
+	TArray<int32> first;		// numGroups + 1
+	TArray<int32> corners;
+
+	void build(const TArray<int32>& indices, const TArray<int32>& groupOfVertex, int32 numGroups)
+	{
+		first.SetNumZeroed(numGroups + 1);
+		for (int32 vertex : indices)
+		{
+			first[groupOfVertex[vertex] + 1]++;
+		}
+		for (auto i = 0; i < numGroups; i++)
+		{
+			first[i + 1] += first[i];
+		}
+		TArray<int32> next(first.GetData(), numGroups);
+		corners.SetNumUninitialized(indices.Num());
+		for (auto i = 0; i < indices.Num(); i++)
+		{
+			corners[next[groupOfVertex[indices[i]]]++] = i;
+		}
+	}
+};
+
+}
+
+
+void DtsComputeTangents(const FVector* positions, const FVector2D* uvs, int32 numVerts, const TArray<const TArray<int32>*>& triangles,
+	TArray<FVector>& normals, TArray<FVector4>& tangents, TArray<FVector4>& mirroredTangents)
+{
+	TArray<int32> indices;
+	for (const TArray<int32>* list : triangles)
+	{
+		for (auto i = 0; i + 2 < list->Num(); i += 3)
+		{
+			const int32* triangle = list->GetData() + i;
+			if (triangle[0] >= 0 && triangle[1] >= 0 && triangle[2] >= 0 && triangle[0] < numVerts && triangle[1] < numVerts && triangle[2] < numVerts)
+			{
+				indices.Append(triangle, 3);
+			}
+		}
+	}
+	const int32 numTriangles = indices.Num() / 3;
+
+	// Per corner face data
+	TArray<FDtsCorner> corners;
+	corners.SetNumUninitialized(indices.Num());
+	ForEachChunk(numTriangles, [&](int32 begin, int32 end)
+	{
+		for (auto t = begin; t < end; t++)
+		{
+			const int32* triangle = indices.GetData() + t * 3;
+			const FVector& p0 = positions[triangle[0]];
+			const FVector& p1 = positions[triangle[1]];
+			const FVector& p2 = positions[triangle[2]];
+			const FVector e1 = p1 - p0;
+			const FVector e2 = p2 - p0;
+			const FVector faceNormal = FVector::CrossProduct(e1, e2).GetSafeNormal();
+
+			FVector sDir = FVector::ZeroVector;
+			FVector tDir = FVector::ZeroVector;
+			const bool mirrored = uvs && DtsIsMirroredUV(uvs[triangle[0]], uvs[triangle[1]], uvs[triangle[2]]);
+			if (uvs)
+			{
+				const FVector2D d1 = uvs[triangle[1]] - uvs[triangle[0]];
+				const FVector2D d2 = uvs[triangle[2]] - uvs[triangle[0]];
+				const float area = d1.X * d2.Y - d1.Y * d2.X;
+				if (FMath::Abs(area) > SMALL_NUMBER)
+				{
+					// Scaling by the sign of the UV area (not its magnitude) keeps mirrored faces pointing the right way
+					const float sign = area > 0.0f ? 1.0f : -1.0f;
+					sDir = ((e1 * d2.Y - e2 * d1.Y) * sign).GetSafeNormal();
+					tDir = ((e2 * d1.X - e1 * d2.X) * sign).GetSafeNormal();
+				}
+			}
+
+			for (auto c = 0; c < 3; c++)
+			{
+				const FVector& p = positions[triangle[c]];
+				const FVector a = (positions[triangle[(c + 1) % 3]] - p).GetSafeNormal();
+				const FVector b = (positions[triangle[(c + 2) % 3]] - p).GetSafeNormal();
+				FDtsCorner& corner = corners[t * 3 + c];
+				corner.faceNormal = faceNormal;
+				corner.sDir = sDir;
+				corner.tDir = tDir;
+				corner.mirrored = mirrored;
+				corner.angle = FMath::Acos(FMath::Clamp(FVector::DotProduct(a, b), -1.0f, 1.0f));
+			}
+		}
+	});
+
+	TArray<int32> vertexGroups;
+	vertexGroups.SetNumUninitialized(numVerts);
+	for (auto i = 0; i < numVerts; i++)
+	{
+		vertexGroups[i] = i;
+	}
+
+	if (normals.Num() != numVerts)
+	{
+		// Smooth over coincident positions so the normal doesn't break along UV seams
+		TMap<FVector, int32> positionGroups;
+		positionGroups.Reserve(numVerts);
+		TArray<int32> weldedGroups;
+		weldedGroups.SetNumUninitialized(numVerts);
+		for (auto i = 0; i < numVerts; i++)
+		{
+			weldedGroups[i] = positionGroups.FindOrAdd(positions[i], positionGroups.Num());
+		}
+		FDtsAdjacency welded;
+		welded.build(indices, weldedGroups, positionGroups.Num());
+		TArray<FVector> groupNormals;
+		groupNormals.SetNumUninitialized(positionGroups.Num());
+		ForEachChunk(positionGroups.Num(), [&](int32 begin, int32 end)
+		{
+			for (auto g = begin; g < end; g++)
+			{
+				FVector sum = FVector::ZeroVector;
+				for (auto i = welded.first[g]; i < welded.first[g + 1]; i++)
+				{
+					const FDtsCorner& corner = corners[welded.corners[i]];
+					sum += corner.faceNormal * corner.angle;
+				}
+				groupNormals[g] = sum.GetSafeNormal();
+			}
+		});
+		normals.SetNumUninitialized(numVerts);
+		for (auto i = 0; i < numVerts; i++)
+		{
+			normals[i] = groupNormals[weldedGroups[i]];
+		}
+	}
+
+	const bool anyMirrored = corners.ContainsByPredicate([](const FDtsCorner& corner) { return corner.mirrored; });
+
+	FDtsAdjacency adjacency;
+	adjacency.build(indices, vertexGroups, numVerts);
+	tangents.SetNumUninitialized(numVerts);
+	mirroredTangents.Reset();
+	if (anyMirrored)
+	{
+		mirroredTangents.SetNumUninitialized(numVerts);
+	}
+	ForEachChunk(numVerts, [&](int32 begin, int32 end)
+	{
+		for (auto v = begin; v < end; v++)
+		{
+			// Corners of each handedness are summed apart, so a mirror seam doesn't average opposite bitangents away
+			FVector normal = normals[v].GetSafeNormal();
+			FVector tangentSum[2] = { FVector::ZeroVector, FVector::ZeroVector };
+			FVector bitangentSum[2] = { FVector::ZeroVector, FVector::ZeroVector };
+			FVector faceSum = FVector::ZeroVector;
+			for (auto i = adjacency.first[v]; i < adjacency.first[v + 1]; i++)
+			{
+				const FDtsCorner& corner = corners[adjacency.corners[i]];
+				faceSum += corner.faceNormal * corner.angle;
+				tangentSum[corner.mirrored] += (corner.sDir - normal * FVector::DotProduct(normal, corner.sDir)).GetSafeNormal() * corner.angle;
+				bitangentSum[corner.mirrored] += (corner.tDir - normal * FVector::DotProduct(normal, corner.tDir)).GetSafeNormal() * corner.angle;
+			}
+			if (normal.IsZero())
+			{
+				normal = faceSum.GetSafeNormal();
+				normals[v] = normal;
+			}
+			for (auto side = 0; side < (anyMirrored ? 2 : 1); side++)
+			{
+				FVector tangent = (tangentSum[side] - normal * FVector::DotProduct(normal, tangentSum[side])).GetSafeNormal();
+				if (tangent.IsZero())
+				{
+					tangent = GetOrthogonal(normal);
+				}
+				const float sign = FVector::DotProduct(FVector::CrossProduct(normal, tangent), bitangentSum[side]) < 0.0f ? -1.0f : 1.0f;
+				(side ? mirroredTangents : tangents)[v] = FVector4(tangent, sign);
+			}
+		}
+	});
+}
@@ -0,0 +1,29 @@
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+// True if the triangle's UVs wind clockwise, i.e. its texture is mirrored relative to the unmirrored faces
+inline bool DtsIsMirroredUV(const FVector2D& uv0, const FVector2D& uv1, const FVector2D& uv2)
+{
+	const FVector2D d1 = uv1 - uv0;
+	const FVector2D d2 = uv2 - uv0;
+	return d1.X * d2.Y - d1.Y * d2.X < -SMALL_NUMBER;
+}
+
+
+// Per vertex tangent frames for a triangulated mesh, in DTS space, built like MikkTSpace builds them: per corner tangent and
+// bitangent directions from the UV derivatives, projected onto the vertex normal and weighted by the corner angle. DTS verts are
+// already split wherever UVs or normals differ; like MikkTSpace, a vertex shared by mirrored and unmirrored faces (a mirror seam)
+// also gets one frame per handedness. Results match the engine's MikkTSpace build in direction, not bit for bit.
+// Triangles (triangle lists of vertex indices) are processed in chunks on worker threads.
+//
+// normals: if it holds numVerts entries they are used as is (the file's normals); otherwise it's filled with angle weighted
+// smooth normals over coincident positions.
+// tangents: filled with the frame of the corners with unmirrored UVs (see DtsIsMirroredUV): the tangent in XYZ and the bitangent
+// sign in W (bitangent = sign * cross(normal, tangent)).
+// mirroredTangents: the same for corners with mirrored UVs; left empty when no triangle is mirrored.
+void DtsComputeTangents(const FVector* positions, const FVector2D* uvs, int32 numVerts, const TArray<const TArray<int32>*>& triangles,
+	TArray<FVector>& normals, TArray<FVector4>& tangents, TArray<FVector4>& mirroredTangents);
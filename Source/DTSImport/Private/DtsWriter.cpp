@@ -0,0 +1,902 @@
+
+
+#include "DtsWriter.h"
+#include "DtsShape.h"
+
+#include <string>
+#include <vector>
+
+
+namespace
+{
+
+// Output region. Without data it only counts bytes, which is how the layout is measured before allocating
+class FDtsRegion
+{
+public:
+	explicit FDtsRegion(uint8* inData = nullptr)
+		: data(inData)
+	{
+	}
+
+	void put(const void* src, int64 size)
+	{
+		if (data)
+		{
+			FMemory::Memcpy(data + pos, src, size);
+		}
+		pos += size;
+	}
+
+	template<typename T>
+	void put(T value)
+	{
+		put(&value, sizeof(T));
+	}
+
+	void putVector(const FVector& v)
+	{
+		put<float>(v.X);
+		put<float>(v.Y);
+		put<float>(v.Z);
+	}
+
+	void putQuat16(const FQuat& q)
+	{
+		put<int16_t>(int16_t(FMath::Clamp(FMath::RoundToInt(q.X * 32767.0f), -32767, 32767)));
+		put<int16_t>(int16_t(FMath::Clamp(FMath::RoundToInt(q.Y * 32767.0f), -32767, 32767)));
+		put<int16_t>(int16_t(FMath::Clamp(FMath::RoundToInt(q.Z * 32767.0f), -32767, 32767)));
+		put<int16_t>(int16_t(FMath::Clamp(FMath::RoundToInt(q.W * 32767.0f), -32767, 32767)));
+	}
+
+	void putBitset(const std::vector<uint32_t>& bits)
+	{
+		put<int32_t>(0);													// Unused word, as Torque writes it
+		put<int32_t>(bits.size());
+		put(bits.data(), bits.size() * sizeof(uint32_t));
+	}
+
+	// Pads to a 32-bit boundary, as every region starts on one
+	void align()
+	{
+		while (pos & 3)
+		{
+			put<uint8_t>(0);
+		}
+	}
+
+	int64 size() const
+	{
+		return pos;
+	}
+
+private:
+	uint8* data;
+	int64 pos = 0;
+};
+
+
+class FDtsShapeWriter
+{
+public:
+	FDtsShapeWriter(const FDtsShape& inShape, uint8* data32, uint8* data16, uint8* data8, uint8* dataTail)
+		: m32(data32)
+		, m16(data16)
+		, m8(data8)
+		, tail(dataTail)
+		, shape(inShape)
+	{
+	}
+
+	void write()
+	{
+		writeMembuffers();
+		m16.align();
+		m8.align();
+		writeTail();
+	}
+
+	FDtsRegion m32;
+	FDtsRegion m16;
+	FDtsRegion m8;
+	FDtsRegion tail;
+
+private:
+	void guard()
+	{
+		m32.put<uint32_t>(guardValue);
+		m16.put<uint16_t>(guardValue);
+		m8.put<uint8_t>(guardValue);
+		guardValue++;
+	}
+
+	void writeMembuffers();
+	void writeMesh(int32 meshIndex);
+	void writeTail();
+
+	const FDtsShape& shape;
+	uint32_t guardValue = 0;
+};
+
+
+void FDtsShapeWriter::writeMembuffers()
+{
+	const int32_t numSubShapes = shape.subShapeFirstObject.size();
+	m32.put<int32_t>(shape.nodes.size());
+	m32.put<int32_t>(shape.objects.size());
+	m32.put<int32_t>(0);														// Decals
+	m32.put<int32_t>(numSubShapes);
+	m32.put<int32_t>(shape.iflMaterials.size());
+	m32.put<int32_t>(shape.nodeRotations.size());
+	m32.put<int32_t>(shape.nodeTranslations.size());
+	m32.put<int32_t>(shape.nodeUniformScales.size());
+	m32.put<int32_t>(shape.nodeAlignedScales.size());
+	m32.put<int32_t>(shape.nodeArbScaleFactors.size());
+	m32.put<int32_t>(shape.groundTranslations.size());
+	m32.put<int32_t>(shape.objectStates.size());
+	m32.put<int32_t>(0);														// Decal states
+	m32.put<int32_t>(shape.triggers.size());
+	m32.put<int32_t>(shape.details.size());
+	m32.put<int32_t>(shape.meshes.size());
+	m32.put<int32_t>(shape.names.size());
+	m32.put<float>(shape.smallestVisibleSize);
+	m32.put<int32_t>(shape.smallestVisibleDL);
+
+	guard();
+
+	m32.put<float>(shape.radius);
+	m32.put<float>(shape.tubeRadius);
+	m32.putVector(shape.center);
+	m32.putVector(shape.bounds.Min);
+	m32.putVector(shape.bounds.Max);
+
+	guard();
+
+	for (const FDtsNode& node : shape.nodes)
+	{
+		m32.put<int32_t>(node.nameIndex);
+		m32.put<int32_t>(node.parentIndex);
+		m32.put<int32_t>(node.firstObject);
+		m32.put<int32_t>(node.firstChild);
+		m32.put<int32_t>(node.nextSibling);
+	}
+
+	guard();
+
+	for (const FDtsObject& object : shape.objects)
+	{
+		m32.put<int32_t>(object.nameIndex);
+		m32.put<int32_t>(object.numMeshes);
+		m32.put<int32_t>(object.startMeshIndex);
+		m32.put<int32_t>(object.nodeIndex);
+		m32.put<int32_t>(object.nextSibling);
+		m32.put<int32_t>(-1);													// First decal
+	}
+
+	guard();
+	guard();																	// No decals between these
+
+	for (const FDtsIflMaterial& ifl : shape.iflMaterials)
+	{
+		m32.put<int32_t>(ifl.nameIndex);
+		m32.put<int32_t>(ifl.materialSlot);
+		m32.put<int32_t>(ifl.firstFrame);
+		m32.put<int32_t>(ifl.firstFrameOffTimeIndex);
+		m32.put<int32_t>(ifl.numFrames);
+	}
+
+	guard();
+
+	for (auto i = 0; i < numSubShapes; i++)
+	{
+		m32.put<int32_t>(i < int32_t(shape.subShapeFirstNode.size()) ? shape.subShapeFirstNode[i] : 0);
+	}
+	m32.put(shape.subShapeFirstObject.data(), numSubShapes * sizeof(int32_t));
+	for (auto i = 0; i < numSubShapes; i++)
+	{
+		m32.put<int32_t>(0);													// First decal
+	}
+
+	guard();
+
+	for (auto i = 0; i < numSubShapes; i++)
+	{
+		m32.put<int32_t>(i < int32_t(shape.subShapeNumNodes.size()) ? shape.subShapeNumNodes[i] : 0);
+	}
+	for (auto i = 0; i < numSubShapes; i++)
+	{
+		m32.put<int32_t>(i < int32_t(shape.subShapeNumObjects.size()) ? shape.subShapeNumObjects[i] : 0);
+	}
+	for (auto i = 0; i < numSubShapes; i++)
+	{
+		m32.put<int32_t>(0);													// Number of decals
+	}
+
+	guard();
+
+	for (const FDtsNode& node : shape.nodes)
+	{
+		m16.putQuat16(node.defaultRotation);
+	}
+	for (const FDtsNode& node : shape.nodes)
+	{
+		m32.putVector(node.defaultTranslation);
+	}
+	for (const FQuat& rotation : shape.nodeRotations)
+	{
+		m16.putQuat16(rotation);
+	}
+	for (const FVector& translation : shape.nodeTranslations)
+	{
+		m32.putVector(translation);
+	}
+
+	guard();
+
+	m32.put(shape.nodeUniformScales.data(), shape.nodeUniformScales.size() * sizeof(float));
+	for (const FVector& scale : shape.nodeAlignedScales)
+	{
+		m32.putVector(scale);
+	}
+	for (const FVector& factor : shape.nodeArbScaleFactors)
+	{
+		m32.putVector(factor);
+	}
+	for (auto i = 0; i < int32_t(shape.nodeArbScaleFactors.size()); i++)
+	{
+		m16.putQuat16(i < int32_t(shape.nodeArbScaleRots.size()) ? shape.nodeArbScaleRots[i] : FQuat::Identity);
+	}
+
+	guard();
+
+	for (const FVector& translation : shape.groundTranslations)
+	{
+		m32.putVector(translation);
+	}
+	for (auto i = 0; i < int32_t(shape.groundTranslations.size()); i++)
+	{
+		m16.putQuat16(i < int32_t(shape.groundRotations.size()) ? shape.groundRotations[i] : FQuat::Identity);
+	}
+
+	guard();
+
+	for (const FDtsObjectState& state : shape.objectStates)
+	{
+		m32.put<float>(state.vis);
+		m32.put<int32_t>(state.frameIndex);
+		m32.put<int32_t>(state.matFrame);
+	}
+
+	guard();
+	guard();																	// No decal states between these
+
+	for (const FDtsTrigger& trigger : shape.triggers)
+	{
+		m32.put<uint32_t>(trigger.state);
+		m32.put<float>(trigger.pos);
+	}
+
+	guard();
+
+	for (const FDtsDetail& detail : shape.details)
+	{
+		m32.put<int32_t>(detail.nameIndex);
+		m32.put<int32_t>(detail.subShapeNum);
+		m32.put<int32_t>(detail.objectDetailNum);
+		m32.put<float>(detail.size);
+		m32.put<float>(detail.averageError);
+		m32.put<float>(detail.maxError);
+		m32.put<int32_t>(detail.polyCount);
+		if (shape.version >= 26)
+		{
+			m32.put<int32_t>(detail.bbDimension);
+			m32.put<int32_t>(detail.bbDetailLevel);
+			m32.put<uint32_t>(detail.bbEquatorSteps);
+			m32.put<uint32_t>(detail.bbPolarSteps);
+			m32.put<float>(detail.bbPolarAngle);
+			m32.put<uint32_t>(detail.bbIncludePoles);
+		}
+	}
+
+	guard();
+
+	for (auto i = 0; i < int32(shape.meshes.size()); i++)
+	{
+		writeMesh(i);
+	}
+
+	guard();
+
+	for (const std::string& name : shape.names)
+	{
+		m8.put(name.c_str(), name.size() + 1);
+	}
+
+	guard();
+
+	for (const FDtsDetail& detail : shape.details)
+	{
+		m32.put<float>(detail.alphaIn);
+	}
+	for (const FDtsDetail& detail : shape.details)
+	{
+		m32.put<float>(detail.alphaOut);
+	}
+}
+
+
+void FDtsShapeWriter::writeMesh(int32 meshIndex)
+{
+	const FDtsMesh& mesh = shape.meshes[meshIndex];
+	const uint32_t meshType = mesh.meshType == DecalMeshType ? uint32_t(NullMeshType) : mesh.meshType;
+	m32.put<uint32_t>(meshType);
+	if (meshType == NullMeshType)
+	{
+		return;
+	}
+
+	guard();
+
+	// Meshes with a parent store counts only; meshes deduplicated on import write the data they share
+	const bool sharedData = mesh.parentMesh >= 0;
+	const FDtsMesh& vertexData = shape.getVertexData(meshIndex);
+	m32.put<int32_t>(mesh.numFrames);
+	m32.put<int32_t>(mesh.numMatFrames);
+	m32.put<int32_t>(mesh.parentMesh);
+	m32.putVector(mesh.bounds.Min);
+	m32.putVector(mesh.bounds.Max);
+	m32.putVector(mesh.center);
+	m32.put<float>(mesh.radius);
+	const int32_t numVerts = sharedData ? mesh.numVerts : vertexData.verts.size();
+	m32.put<int32_t>(numVerts);
+	for (auto i = 0; !sharedData && i < numVerts; i++)
+	{
+		m32.putVector(vertexData.verts[i]);
+	}
+	m32.put<int32_t>(sharedData ? mesh.numTVerts : int32_t(vertexData.tverts.size()));
+	for (auto i = 0; !sharedData && i < int32_t(vertexData.tverts.size()); i++)
+	{
+		m32.put<float>(vertexData.tverts[i].X);
+		m32.put<float>(vertexData.tverts[i].Y);
+	}
+	if (shape.version >= 26)
+	{
+		m32.put<int32_t>(sharedData ? mesh.numTVerts2 : int32_t(vertexData.tverts2.size()));
+		for (auto i = 0; !sharedData && i < int32_t(vertexData.tverts2.size()); i++)
+		{
+			m32.put<float>(vertexData.tverts2[i].X);
+			m32.put<float>(vertexData.tverts2[i].Y);
+		}
+		m32.put<int32_t>(sharedData ? mesh.numColors : int32_t(vertexData.colors.size()));
+		for (auto i = 0; !sharedData && i < int32_t(vertexData.colors.size()); i++)
+		{
+			m32.put<uint32_t>(vertexData.colors[i]);
+		}
+	}
+	for (auto i = 0; !sharedData && i < numVerts; i++)
+	{
+		m32.putVector(i < int32_t(vertexData.norms.size()) ? vertexData.norms[i] : FVector::ZeroVector);
+	}
+	for (auto i = 0; !sharedData && i < numVerts; i++)
+	{
+		m8.put<uint8_t>(i < int32_t(vertexData.encodedNorms.size()) ? vertexData.encodedNorms[i] : 0);
+	}
+
+	m32.put<int32_t>(mesh.primitives.size());
+	if (shape.version <= 24)
+	{
+		for (const FDtsPrimitive& primitive : mesh.primitives)
+		{
+			m16.put<int16_t>(primitive.start);
+			m16.put<int16_t>(primitive.numElements);
+		}
+		for (const FDtsPrimitive& primitive : mesh.primitives)
+		{
+			m32.put<uint32_t>(primitive.matIndex);
+		}
+	}
+	else
+	{
+		for (const FDtsPrimitive& primitive : mesh.primitives)
+		{
+			m32.put<int32_t>(primitive.start);
+			m32.put<int32_t>(primitive.numElements);
+			m32.put<uint32_t>(primitive.matIndex);
+		}
+	}
+
+	m32.put<int32_t>(mesh.indices.size());
+	if (shape.version <= 25)
+	{
+		for (int32_t index : mesh.indices)
+		{
+			m16.put<int16_t>(index);
+		}
+	}
+	else
+	{
+		m32.put(mesh.indices.data(), mesh.indices.size() * sizeof(int32_t));
+	}
+
+	m32.put<int32_t>(0);														// Merge indices
+	m32.put<int32_t>(mesh.vertsPerFrame);
+	m32.put<uint32_t>(mesh.flags);
+
+	guard();
+
+	if (meshType == SkinMeshType)
+	{
+		const FDtsSkin& skin = mesh.skin;
+		m32.put<int32_t>(sharedData ? skin.numInitialVerts : int32_t(skin.initialVerts.size()));
+		for (const FVector& vert : skin.initialVerts)
+		{
+			m32.putVector(vert);
+		}
+		for (auto i = 0; i < int32_t(skin.initialVerts.size()); i++)
+		{
+			m32.putVector(i < int32_t(skin.initialNorms.size()) ? skin.initialNorms[i] : FVector::ZeroVector);
+		}
+		for (auto i = 0; i < int32_t(skin.initialVerts.size()); i++)
+		{
+			m8.put<uint8_t>(i < int32_t(skin.initialEncodedNorms.size()) ? skin.initialEncodedNorms[i] : 0);
+		}
+		m32.put<int32_t>(sharedData ? skin.numInitialTransforms : int32_t(skin.initialTransforms.size()));
+		for (const FMatrix& transform : skin.initialTransforms)
+		{
+			for (auto n = 0; n < 16; n++)
+			{
+				m32.put<float>(transform.M[n / 4][n % 4]);
+			}
+		}
+		m32.put<int32_t>(sharedData ? skin.numVertIndices : int32_t(skin.vertIndices.size()));
+		m32.put(skin.vertIndices.data(), skin.vertIndices.size() * sizeof(int32_t));
+		m32.put<int32_t>(sharedData ? skin.numBoneIndices : int32_t(skin.boneIndices.size()));
+		m32.put(skin.boneIndices.data(), skin.boneIndices.size() * sizeof(int32_t));
+		m32.put<int32_t>(sharedData ? skin.numWeights : int32_t(skin.weights.size()));
+		m32.put(skin.weights.data(), skin.weights.size() * sizeof(float));
+		m32.put<int32_t>(sharedData ? skin.numNodeIndices : int32_t(skin.nodeIndices.size()));
+		m32.put(skin.nodeIndices.data(), skin.nodeIndices.size() * sizeof(int32_t));
+
+		guard();
+	}
+
+	if (meshType == SortedMeshType)
+	{
+		m32.put<int32_t>(mesh.clusters.size());
+		for (const FDtsCluster& cluster : mesh.clusters)
+		{
+			m32.put<int32_t>(cluster.startPrimitive);
+			m32.put<int32_t>(cluster.endPrimitive);
+			m32.putVector(cluster.normal);
+			m32.put<float>(cluster.k);
+			m32.put<int32_t>(cluster.frontCluster);
+			m32.put<int32_t>(cluster.backCluster);
+		}
+		m32.put<int32_t>(mesh.startClusters.size());
+		m32.put(mesh.startClusters.data(), mesh.startClusters.size() * sizeof(int32_t));
+		m32.put<int32_t>(mesh.firstVerts.size());
+		m32.put(mesh.firstVerts.data(), mesh.firstVerts.size() * sizeof(int32_t));
+		m32.put<int32_t>(mesh.clusterNumVerts.size());
+		m32.put(mesh.clusterNumVerts.data(), mesh.clusterNumVerts.size() * sizeof(int32_t));
+		m32.put<int32_t>(mesh.firstTVerts.size());
+		m32.put(mesh.firstTVerts.data(), mesh.firstTVerts.size() * sizeof(int32_t));
+		m32.put<int32_t>(mesh.alwaysWriteDepth ? 1 : 0);
+
+		guard();
+	}
+}
+
+
+void FDtsShapeWriter::writeTail()
+{
+	tail.put<int32_t>(shape.sequences.size());
+	for (const FDtsSequence& sequence : shape.sequences)
+	{
+		tail.put<int32_t>(sequence.nameIndex);
+		tail.put<uint32_t>(sequence.flags);
+		tail.put<int32_t>(sequence.numKeyframes);
+		tail.put<float>(sequence.duration);
+		tail.put<int32_t>(sequence.priority);
+		tail.put<int32_t>(sequence.firstGroundFrame);
+		tail.put<int32_t>(sequence.numGroundFrames);
+		tail.put<int32_t>(sequence.baseRotation);
+		tail.put<int32_t>(sequence.baseTranslation);
+		tail.put<int32_t>(sequence.baseScale);
+		tail.put<int32_t>(sequence.baseObjectState);
+		tail.put<int32_t>(0);													// Base decal state
+		tail.put<int32_t>(sequence.firstTrigger);
+		tail.put<int32_t>(sequence.numTriggers);
+		tail.put<float>(sequence.toolBegin);
+		tail.putBitset(sequence.rotationMatters);
+		tail.putBitset(sequence.translationMatters);
+		tail.putBitset(sequence.scaleMatters);
+		tail.putBitset(std::vector<uint32_t>());								// Decals
+		tail.putBitset(sequence.iflMatters);
+		tail.putBitset(sequence.visMatters);
+		tail.putBitset(sequence.frameMatters);
+		tail.putBitset(sequence.matFrameMatters);
+	}
+
+	tail.put<int8_t>(1);														// Material list stream type
+	tail.put<int32_t>(shape.materials.size());
+	for (const FDtsMaterial& material : shape.materials)
+	{
+		const uint8_t length = uint8_t(FMath::Min<size_t>(material.name.size(), 255));
+		tail.put<uint8_t>(length);
+		tail.put(material.name.c_str(), length);
+	}
+	for (const FDtsMaterial& material : shape.materials)
+	{
+		tail.put<uint32_t>(material.flags);
+	}
+	for (const FDtsMaterial& material : shape.materials)
+	{
+		tail.put<int32_t>(material.reflectanceMap);
+	}
+	for (const FDtsMaterial& material : shape.materials)
+	{
+		tail.put<int32_t>(material.bumpMap);
+	}
+	for (const FDtsMaterial& material : shape.materials)
+	{
+		tail.put<int32_t>(material.detailMap);
+	}
+	if (shape.version == 25)
+	{
+		for (auto i = 0; i < int32_t(shape.materials.size()); i++)
+		{
+			tail.put<int32_t>(0);
+		}
+	}
+	for (const FDtsMaterial& material : shape.materials)
+	{
+		tail.put<float>(material.detailScale);
+	}
+	for (const FDtsMaterial& material : shape.materials)
+	{
+		tail.put<float>(material.reflectance);
+	}
+}
+
+
+int32 CountBits(const std::vector<uint32_t>& bits)
+{
+	int32 count = 0;
+	for (uint32_t word : bits)
+	{
+		count += FPlatformMath::CountBits(word);
+	}
+	return count;
+}
+
+
+// Copies the key ranges sequences refer to into a fresh array, once per distinct range, and rebases the sequences on it
+template<typename T>
+class FDtsKeyCompactor
+{
+public:
+	explicit FDtsKeyCompactor(const std::vector<T>& inKeys)
+		: keys(inKeys)
+	{
+	}
+
+	int32_t add(int32_t first, int32_t count)
+	{
+		if (count <= 0)
+		{
+			return 0;
+		}
+		const TPair<int32_t, int32_t> range(first, count);
+		if (const int32_t* found = ranges.Find(range))
+		{
+			return *found;
+		}
+		const int32_t start = compacted.size();
+		for (auto i = first; i < first + count; i++)
+		{
+			compacted.push_back(i >= 0 && i < int32_t(keys.size()) ? keys[i] : T());
+		}
+		ranges.Add(range, start);
+		return start;
+	}
+
+	int32 finish(std::vector<T>& out)
+	{
+		const int32 dropped = int32(out.size()) - int32(compacted.size());
+		out.swap(compacted);
+		return FMath::Max(dropped, 0);
+	}
+
+private:
+	const std::vector<T>& keys;
+	std::vector<T> compacted;
+	TMap<TPair<int32_t, int32_t>, int32_t> ranges;
+};
+
+}
+
+
+void DtsOptimizeShape(FDtsShape& shape, FDtsOptimizeStats& stats)
+{
+	for (FDtsMesh& mesh : shape.meshes)
+	{
+		if (mesh.meshType == DecalMeshType)
+		{
+			mesh = FDtsMesh();
+			stats.numDecalMeshes++;
+		}
+	}
+	for (FDtsObject& object : shape.objects)
+	{
+		object.firstDecal = -1;
+	}
+
+	// Keyframes: only the ranges sequences refer to survive
+	FDtsKeyCompactor<FQuat> rotations(shape.nodeRotations);
+	FDtsKeyCompactor<FVector> translations(shape.nodeTranslations);
+	FDtsKeyCompactor<float> uniformScales(shape.nodeUniformScales);
+	FDtsKeyCompactor<FVector> alignedScales(shape.nodeAlignedScales);
+	FDtsKeyCompactor<FVector> arbScaleFactors(shape.nodeArbScaleFactors);
+	FDtsKeyCompactor<FQuat> arbScaleRots(shape.nodeArbScaleRots);
+	FDtsKeyCompactor<FVector> groundTranslations(shape.groundTranslations);
+	FDtsKeyCompactor<FQuat> groundRotations(shape.groundRotations);
+	FDtsKeyCompactor<FDtsObjectState> objectStates(shape.objectStates);
+	FDtsKeyCompactor<FDtsTrigger> triggers(shape.triggers);
+	for (FDtsSequence& sequence : shape.sequences)
+	{
+		const int32_t numKeys = sequence.numKeyframes;
+		sequence.baseRotation = rotations.add(sequence.baseRotation, CountBits(sequence.rotationMatters) * numKeys);
+		sequence.baseTranslation = translations.add(sequence.baseTranslation, CountBits(sequence.translationMatters) * numKeys);
+		const int32_t numScaleKeys = CountBits(sequence.scaleMatters) * numKeys;
+		if (sequence.flags & SequenceArbitraryScale)
+		{
+			const int32_t base = arbScaleFactors.add(sequence.baseScale, numScaleKeys);
+			arbScaleRots.add(sequence.baseScale, numScaleKeys);
+			sequence.baseScale = base;
+		}
+		else if (sequence.flags & SequenceAlignedScale)
+		{
+			sequence.baseScale = alignedScales.add(sequence.baseScale, numScaleKeys);
+		}
+		else if (sequence.flags & SequenceUniformScale)
+		{
+			sequence.baseScale = uniformScales.add(sequence.baseScale, numScaleKeys);
+		}
+		// Objects with any animated state have a key per frame
+		std::vector<uint32_t> objectMatters = sequence.frameMatters;
+		objectMatters.resize(FMath::Max(FMath::Max(objectMatters.size(), sequence.matFrameMatters.size()), sequence.visMatters.size()), 0);
+		for (auto i = 0; i < int32(objectMatters.size()); i++)
+		{
+			objectMatters[i] |= (i < int32(sequence.matFrameMatters.size()) ? sequence.matFrameMatters[i] : 0) | (i < int32(sequence.visMatters.size()) ? sequence.visMatters[i] : 0);
+		}
+		sequence.baseObjectState = objectStates.add(sequence.baseObjectState, CountBits(objectMatters) * numKeys);
+		const int32_t firstGround = groundTranslations.add(sequence.firstGroundFrame, sequence.numGroundFrames);
+		groundRotations.add(sequence.firstGroundFrame, sequence.numGroundFrames);
+		sequence.firstGroundFrame = firstGround;
+		sequence.firstTrigger = triggers.add(sequence.firstTrigger, sequence.numTriggers);
+		sequence.baseDecalState = 0;
+		sequence.decalMatters.clear();
+	}
+	stats.numKeysDropped += rotations.finish(shape.nodeRotations);
+	stats.numKeysDropped += translations.finish(shape.nodeTranslations);
+	stats.numKeysDropped += uniformScales.finish(shape.nodeUniformScales);
+	stats.numKeysDropped += alignedScales.finish(shape.nodeAlignedScales);
+	stats.numKeysDropped += arbScaleFactors.finish(shape.nodeArbScaleFactors);
+	arbScaleRots.finish(shape.nodeArbScaleRots);
+	stats.numKeysDropped += groundTranslations.finish(shape.groundTranslations);
+	groundRotations.finish(shape.groundRotations);
+	stats.numKeysDropped += objectStates.finish(shape.objectStates);
+	stats.numKeysDropped += triggers.finish(shape.triggers);
+
+	// Names: keep those something refers to, in their original order
+	std::vector<int32_t> remap(shape.names.size(), -1);
+	auto use = [&remap](int32_t nameIndex)
+	{
+		if (nameIndex >= 0 && nameIndex < int32_t(remap.size()))
+		{
+			remap[nameIndex] = 0;
+		}
+	};
+	for (const FDtsNode& node : shape.nodes) use(node.nameIndex);
+	for (const FDtsObject& object : shape.objects) use(object.nameIndex);
+	for (const FDtsDetail& detail : shape.details) use(detail.nameIndex);
+	for (const FDtsSequence& sequence : shape.sequences) use(sequence.nameIndex);
+	for (const FDtsIflMaterial& ifl : shape.iflMaterials) use(ifl.nameIndex);
+	std::vector<std::string> names;
+	for (auto i = 0; i < int32_t(shape.names.size()); i++)
+	{
+		if (remap[i] >= 0)
+		{
+			remap[i] = names.size();
+			names.push_back(shape.names[i]);
+		}
+	}
+	stats.numNamesDropped += int32(shape.names.size() - names.size());
+	shape.names.swap(names);
+	auto rename = [&remap](int32_t& nameIndex)
+	{
+		if (nameIndex >= 0 && nameIndex < int32_t(remap.size()))
+		{
+			nameIndex = remap[nameIndex];
+		}
+	};
+	for (FDtsNode& node : shape.nodes) rename(node.nameIndex);
+	for (FDtsObject& object : shape.objects) rename(object.nameIndex);
+	for (FDtsDetail& detail : shape.details) rename(detail.nameIndex);
+	for (FDtsSequence& sequence : shape.sequences) rename(sequence.nameIndex);
+	for (FDtsIflMaterial& ifl : shape.iflMaterials) rename(ifl.nameIndex);
+}
+
+
+namespace
+{
+
+bool EqualKey(const FQuat& a, const FQuat& b) { return a.Equals(b, KINDA_SMALL_NUMBER); }
+bool EqualKey(const FVector& a, const FVector& b) { return a.Equals(b, KINDA_SMALL_NUMBER); }
+bool EqualKey(float a, float b) { return FMath::IsNearlyEqual(a, b); }
+bool EqualKey(const FDtsObjectState& a, const FDtsObjectState& b) { return FMath::IsNearlyEqual(a.vis, b.vis) && a.frameIndex == b.frameIndex && a.matFrame == b.matFrame; }
+bool EqualKey(const FDtsTrigger& a, const FDtsTrigger& b) { return a.state == b.state && FMath::IsNearlyEqual(a.pos, b.pos); }
+
+
+template<typename T>
+bool EqualKeys(const std::vector<T>& a, int32_t firstA, const std::vector<T>& b, int32_t firstB, int32_t count)
+{
+	for (auto i = 0; i < count; i++)
+	{
+		const bool inA = firstA + i >= 0 && firstA + i < int32_t(a.size());
+		const bool inB = firstB + i >= 0 && firstB + i < int32_t(b.size());
+		if (inA != inB || (inA && !EqualKey(a[firstA + i], b[firstB + i])))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+template<typename T>
+bool EqualArrays(const std::vector<T>& a, const std::vector<T>& b)
+{
+	return a.size() == b.size() && EqualKeys(a, 0, b, 0, a.size());
+}
+
+}
+
+
+bool DtsCompareOptimizedShape(const FDtsShape& original, const FDtsShape& optimized, FString& difference)
+{
+	auto fail = [&difference](const FString& what)
+	{
+		difference = what;
+		return false;
+	};
+	if (original.nodes.size() != optimized.nodes.size() || original.objects.size() != optimized.objects.size() || original.meshes.size() != optimized.meshes.size()
+		|| original.details.size() != optimized.details.size() || original.materials.size() != optimized.materials.size() || original.sequences.size() != optimized.sequences.size())
+	{
+		return fail(TEXT("node, object, mesh, detail, material or sequence count"));
+	}
+	for (auto i = 0; i < int32(original.nodes.size()); i++)
+	{
+		const FDtsNode& a = original.nodes[i];
+		const FDtsNode& b = optimized.nodes[i];
+		if (original.getName(a.nameIndex) != optimized.getName(b.nameIndex) || a.parentIndex != b.parentIndex
+			|| !EqualKey(a.defaultRotation, b.defaultRotation) || !EqualKey(a.defaultTranslation, b.defaultTranslation))
+		{
+			return fail(FString::Printf(TEXT("node %d"), i));
+		}
+	}
+	for (auto i = 0; i < int32(original.objects.size()); i++)
+	{
+		const FDtsObject& a = original.objects[i];
+		const FDtsObject& b = optimized.objects[i];
+		if (original.getName(a.nameIndex) != optimized.getName(b.nameIndex) || a.nodeIndex != b.nodeIndex || a.startMeshIndex != b.startMeshIndex || a.numMeshes != b.numMeshes)
+		{
+			return fail(FString::Printf(TEXT("object %d"), i));
+		}
+	}
+	for (auto i = 0; i < int32(original.details.size()); i++)
+	{
+		const FDtsDetail& a = original.details[i];
+		const FDtsDetail& b = optimized.details[i];
+		if (original.getName(a.nameIndex) != optimized.getName(b.nameIndex) || a.subShapeNum != b.subShapeNum || a.objectDetailNum != b.objectDetailNum || a.size != b.size)
+		{
+			return fail(FString::Printf(TEXT("detail %d"), i));
+		}
+	}
+	for (auto i = 0; i < int32(original.materials.size()); i++)
+	{
+		const FDtsMaterial& a = original.materials[i];
+		const FDtsMaterial& b = optimized.materials[i];
+		if (a.name != b.name || a.flags != b.flags || a.bumpMap != b.bumpMap || a.detailMap != b.detailMap || a.reflectanceMap != b.reflectanceMap)
+		{
+			return fail(FString::Printf(TEXT("material %d"), i));
+		}
+	}
+	for (auto i = 0; i < int32(original.meshes.size()); i++)
+	{
+		const FDtsMesh& a = original.meshes[i];
+		const FDtsMesh& b = optimized.meshes[i];
+		if (a.meshType == DecalMeshType)
+		{
+			continue;
+		}
+		const FDtsMesh& dataA = original.getVertexData(i);
+		const FDtsMesh& dataB = optimized.getVertexData(i);
+		if (a.meshType != b.meshType || a.parentMesh != b.parentMesh || !EqualArrays(dataA.verts, dataB.verts) || !EqualArrays(dataA.norms, dataB.norms)
+			|| dataA.tverts != dataB.tverts || a.indices != b.indices || a.primitives.size() != b.primitives.size()
+			|| a.skin.vertIndices != b.skin.vertIndices || a.skin.boneIndices != b.skin.boneIndices || a.skin.nodeIndices != b.skin.nodeIndices
+			|| !EqualArrays(a.skin.initialVerts, b.skin.initialVerts) || !EqualArrays(a.skin.weights, b.skin.weights))
+		{
+			return fail(FString::Printf(TEXT("mesh %d"), i));
+		}
+		for (auto p = 0; p < int32(a.primitives.size()); p++)
+		{
+			if (a.primitives[p].start != b.primitives[p].start || a.primitives[p].numElements != b.primitives[p].numElements || a.primitives[p].matIndex != b.primitives[p].matIndex)
+			{
+				return fail(FString::Printf(TEXT("mesh %d primitive %d"), i, p));
+			}
+		}
+	}
+	for (auto i = 0; i < int32(original.sequences.size()); i++)
+	{
+		const FDtsSequence& a = original.sequences[i];
+		const FDtsSequence& b = optimized.sequences[i];
+		const FString name = UTF8_TO_TCHAR(original.getName(a.nameIndex).c_str());
+		if (original.getName(a.nameIndex) != optimized.getName(b.nameIndex) || a.flags != b.flags || a.numKeyframes != b.numKeyframes || a.duration != b.duration
+			|| a.rotationMatters != b.rotationMatters || a.translationMatters != b.translationMatters || a.scaleMatters != b.scaleMatters
+			|| a.visMatters != b.visMatters || a.frameMatters != b.frameMatters || a.matFrameMatters != b.matFrameMatters
+			|| a.numGroundFrames != b.numGroundFrames || a.numTriggers != b.numTriggers)
+		{
+			return fail(FString::Printf(TEXT("sequence [%s]"), *name));
+		}
+		const int32_t numKeys = a.numKeyframes;
+		const int32_t numScaleKeys = CountBits(a.scaleMatters) * numKeys;
+		const bool scalesMatch = (a.flags & SequenceArbitraryScale) ? EqualKeys(original.nodeArbScaleFactors, a.baseScale, optimized.nodeArbScaleFactors, b.baseScale, numScaleKeys)
+				&& EqualKeys(original.nodeArbScaleRots, a.baseScale, optimized.nodeArbScaleRots, b.baseScale, numScaleKeys)
+			: (a.flags & SequenceAlignedScale) ? EqualKeys(original.nodeAlignedScales, a.baseScale, optimized.nodeAlignedScales, b.baseScale, numScaleKeys)
+			: (a.flags & SequenceUniformScale) ? EqualKeys(original.nodeUniformScales, a.baseScale, optimized.nodeUniformScales, b.baseScale, numScaleKeys)
+			: true;
+		if (!EqualKeys(original.nodeRotations, a.baseRotation, optimized.nodeRotations, b.baseRotation, CountBits(a.rotationMatters) * numKeys)
+			|| !EqualKeys(original.nodeTranslations, a.baseTranslation, optimized.nodeTranslations, b.baseTranslation, CountBits(a.translationMatters) * numKeys)
+			|| !scalesMatch)
+		{
+			return fail(FString::Printf(TEXT("node keyframes of sequence [%s]"), *name));
+		}
+		if (!EqualKeys(original.groundTranslations, a.firstGroundFrame, optimized.groundTranslations, b.firstGroundFrame, a.numGroundFrames)
+			|| !EqualKeys(original.groundRotations, a.firstGroundFrame, optimized.groundRotations, b.firstGroundFrame, a.numGroundFrames)
+			|| !EqualKeys(original.triggers, a.firstTrigger, optimized.triggers, b.firstTrigger, a.numTriggers))
+		{
+			return fail(FString::Printf(TEXT("ground frames or triggers of sequence [%s]"), *name));
+		}
+	}
+	return true;
+}
+
+
+int64 DtsWriteShape(const FDtsShape& shape, TArray<uint8>& buffer)
+{
+	// Measure, then write each region straight into its place in one buffer
+	FDtsShapeWriter measure(shape, nullptr, nullptr, nullptr, nullptr);
+	measure.write();
+	const int64 size32 = measure.m32.size();
+	const int64 size16 = measure.m16.size();
+	const int64 size8 = measure.m8.size();
+	const int64 headerSize = sizeof(uint32_t) * 4;
+	const int64 totalSize = headerSize + size32 + size16 + size8 + measure.tail.size();
+	buffer.SetNumUninitialized(totalSize);
+
+	uint8* data = buffer.GetData();
+	const uint32_t header[4] =
+	{
+		shape.version,
+		uint32_t((size32 + size16 + size8) / 4),								// Membuffer size in 32-bit words
+		uint32_t(size32 / 4),													// Start of the 16-bit region
+		uint32_t((size32 + size16) / 4),										// Start of the 8-bit region
+	};
+	FMemory::Memcpy(data, header, headerSize);
+	uint8* data32 = data + headerSize;
+	FDtsShapeWriter writer(shape, data32, data32 + size32, data32 + size32 + size16, data32 + size32 + size16 + size8);
+	writer.write();
+	check(writer.m32.size() == size32 && writer.m16.size() == size16 && writer.m8.size() == size8);
+	return totalSize;
+}
@@ -0,0 +1,30 @@
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FDtsShape;
+
+
+// What DtsOptimizeShape removed
+struct FDtsOptimizeStats
+{
+	int32 numDecalMeshes = 0;				// Deprecated decal meshes replaced by null meshes
+	int32 numNamesDropped = 0;				// Names nothing refers to
+	int32 numKeysDropped = 0;				// Keyframes (node, scale, ground, object state) and triggers no sequence refers to
+};
+
+
+// Strips what Torque no longer uses and what nothing refers to: decal meshes, unreferenced names and keyframes.
+// Decals, decal states and merge indices are never kept by the parser, so they are always left out of written files.
+void DtsOptimizeShape(FDtsShape& shape, FDtsOptimizeStats& stats);
+
+// Checks that optimized (usually parsed back from a written file) still describes original: the same nodes, objects, names,
+// details, materials, mesh geometry and sequences, with every keyframe and trigger a sequence refers to unchanged.
+// Returns false and the first difference found otherwise.
+bool DtsCompareOptimizedShape(const FDtsShape& original, const FDtsShape& optimized, FString& difference);
+
+// Serializes the shape in the layout the parser reads (header, 32/16/8-bit membuffer regions with guard words,
+// sequences and materials), in shape.version. The size is measured first and buffer is allocated once.
+int64 DtsWriteShape(const FDtsShape& shape, TArray<uint8>& buffer);